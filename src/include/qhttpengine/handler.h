@@ -73,6 +73,16 @@ class QHTTPENGINE_EXPORT HandlerPrivate;
  * passed along to the process() method, which is expected to either process
  * the request or write an error to the socket. The default implementation of
  * process() simply returns an HTTP 404 error.
+ *
+ * When a [Server](@ref QHttpEngine::Server) uses worker threads, route() and
+ * process() are invoked on the worker thread that owns the socket, so the
+ * same handler may be processing requests on several threads at once. The
+ * handler tree (including middleware) must therefore not be modified once
+ * the server is listening, and process() may only read the state of the
+ * handler unless it protects that state itself. Objects created for a
+ * request should be parented to the socket (or not at all) rather than to
+ * the handler, which lives on another thread. The handlers provided by this
+ * library meet these requirements.
  */
 class QHTTPENGINE_EXPORT Handler : public QObject
 {
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_HEADERLIST_H
+#define QHTTPENGINE_HEADERLIST_H
+
+#include <QByteArray>
+#include <QMultiMap>
+
+#include <qhttpengine/ibytearray.h>
+
+#include "qhttpengine_export.h"
+
+namespace QHttpEngine
+{
+
+class QHTTPENGINE_EXPORT HeaderListPrivate;
+
+/**
+ * @brief Flat list of HTTP headers
+ *
+ * Headers are stored in the order they were received in a single buffer
+ * rather than as separate nodes in a map. Commonly used headers are assigned
+ * an Id when they are inserted so that they can be retrieved in constant time
+ * without comparing names:
+ *
+ * @code
+ * QHttpEngine::HeaderList headers;
+ * headers.insert("content-length", "13");
+ *
+ * headers.value(QHttpEngine::HeaderList::ContentLength); // "13"
+ * headers.value("Content-Length");                       // "13"
+ * @endcode
+ *
+ * Names are compared without regard to case. If a header appears more than
+ * once, value() returns the last value, matching the behavior of
+ * QMultiMap::value(). All of the headers can be retrieved with nameAt() and
+ * valueAt() or converted to a map with toMap().
+ */
+class QHTTPENGINE_EXPORT HeaderList
+{
+public:
+
+    /**
+     * @brief Well-known headers
+     */
+    enum Id {
+        /// Header without an Id
+        Unknown = -1,
+        Accept = 0,
+        AcceptEncoding,
+        AcceptLanguage,
+        Authorization,
+        CacheControl,
+        Connection,
+        ContentLength,
+        ContentType,
+        Cookie,
+        Expect,
+        Host,
+        IfModifiedSince,
+        IfNoneMatch,
+        IfRange,
+        KeepAlive,
+        Origin,
+        Range,
+        Referer,
+        TransferEncoding,
+        Upgrade,
+        UserAgent,
+        XForwardedFor,
+        XRealIP,
+        /// Number of well-known headers
+        IdCount
+    };
+
+    /**
+     * @brief Create an empty list of headers
+     */
+    HeaderList();
+
+    /**
+     * @brief Create a copy of another list of headers
+     */
+    HeaderList(const HeaderList &other);
+
+    /**
+     * @brief Destroy the list of headers
+     */
+    ~HeaderList();
+
+    /**
+     * @brief Assignment operator
+     */
+    HeaderList &operator=(const HeaderList &other);
+
+    /**
+     * @brief Retrieve the Id of the header with the specified name
+     *
+     * Unknown is returned if the header is not a well-known one.
+     */
+    static Id id(const char *name, int length);
+
+    /**
+     * @brief Retrieve the Id of the header with the specified name
+     */
+    static Id id(const QByteArray &name);
+
+    /**
+     * @brief Retrieve the name of a well-known header
+     */
+    static QByteArray name(Id id);
+
+    /**
+     * @brief Add a header to the end of the list
+     */
+    void insert(const char *name, int nameLength, const char *value, int valueLength);
+
+    /**
+     * @brief Add a header to the end of the list
+     */
+    void insert(const QByteArray &name, const QByteArray &value);
+
+    /**
+     * @brief Remove all of the headers
+     */
+    void clear();
+
+    /**
+     * @brief Retrieve the number of headers in the list
+     */
+    int count() const;
+
+    /**
+     * @brief Retrieve the name of the header at the specified index
+     */
+    QByteArray nameAt(int index) const;
+
+    /**
+     * @brief Retrieve the value of the header at the specified index
+     */
+    QByteArray valueAt(int index) const;
+
+    /**
+     * @brief Retrieve the Id of the header at the specified index
+     */
+    Id idAt(int index) const;
+
+    /**
+     * @brief Determine if a well-known header is present
+     */
+    bool contains(Id id) const;
+
+    /**
+     * @brief Determine if a header with the specified name is present
+     */
+    bool contains(const QByteArray &name) const;
+
+    /**
+     * @brief Retrieve the value of a well-known header
+     *
+     * A null QByteArray is returned if the header is not present.
+     */
+    QByteArray value(Id id) const;
+
+    /**
+     * @brief Retrieve the value of the header with the specified name
+     */
+    QByteArray value(const QByteArray &name) const;
+
+    /**
+     * @brief Convert the list to a map of headers
+     *
+     * The map has the same type as Socket::HeaderMap.
+     */
+    QMultiMap<IByteArray, QByteArray> toMap() const;
+
+private:
+
+    HeaderListPrivate *const d;
+};
+
+}
+
+#endif // QHTTPENGINE_HEADERLIST_H
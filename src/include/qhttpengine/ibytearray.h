@@ -23,9 +23,8 @@
 #ifndef QHTTPENGINE_IBYTEARRAY_H
 #define QHTTPENGINE_IBYTEARRAY_H
 
-#include <cctype>
-
 #include <QByteArray>
+#include <QString>
 
 #include "qhttpengine_export.h"
 
@@ -36,7 +35,10 @@ namespace QHttpEngine
  * @brief Case-insensitive subclass of QByteArray
  *
  * The IByteArray is identical to the QByteArray class in all aspects except
- * that it performs comparisons in a case-insensitive manner.
+ * that it performs comparisons in a case-insensitive manner. Only ASCII
+ * letters are folded and comparisons are performed in place without creating
+ * temporary copies of either operand. The qHash() overload for IByteArray
+ * allows it to be used as a key in hash-based containers.
  */
 class QHTTPENGINE_EXPORT IByteArray : public QByteArray
 {
@@ -48,54 +50,88 @@ public:
     IByteArray(const IByteArray &other) : QByteArray(other) {}
     IByteArray(const char *data, int size = -1) : QByteArray(data, size) {}
 
-    inline bool operator==(const QString &s2) const { return toLower() == s2.toLower(); }
-    inline bool operator!=(const QString &s2) const { return toLower() != s2.toLower(); }
-    inline bool operator<(const QString &s2) const { return toLower() < s2.toLower(); }
-    inline bool operator>(const QString &s2) const { return toLower() > s2.toLower(); }
-    inline bool operator<=(const QString &s2) const { return toLower() <= s2.toLower(); }
-    inline bool operator>=(const QString &s2) const { return toLower() >= s2.toLower(); }
+    inline bool operator==(const QString &s2) const { return caseInsensitiveCompare(*this, s2) == 0; }
+    inline bool operator!=(const QString &s2) const { return caseInsensitiveCompare(*this, s2) != 0; }
+    inline bool operator<(const QString &s2) const { return caseInsensitiveCompare(*this, s2) < 0; }
+    inline bool operator>(const QString &s2) const { return caseInsensitiveCompare(*this, s2) > 0; }
+    inline bool operator<=(const QString &s2) const { return caseInsensitiveCompare(*this, s2) <= 0; }
+    inline bool operator>=(const QString &s2) const { return caseInsensitiveCompare(*this, s2) >= 0; }
+
+    bool contains(char c) const { return caseInsensitiveIndexOf(constData(), size(), &c, 1) != -1; }
+    bool contains(const char *c) const { return caseInsensitiveIndexOf(constData(), size(), c, qstrlen(c)) != -1; }
+    bool contains(const QByteArray &a) const { return caseInsensitiveIndexOf(constData(), size(), a.constData(), a.size()) != -1; }
+    /// \}
+
+    /**
+     * @brief Compare two strings without regard to case
+     *
+     * The return value is less than, equal to or greater than zero if the
+     * first string is less than, equal to or greater than the second.
+     */
+    static int caseInsensitiveCompare(const char *data1, int size1, const char *data2, int size2);
 
-    bool contains(char c) const { return toLower().contains(tolower(c)); }
-    bool contains(const char *c) const { return toLower().contains(QByteArray(c).toLower()); }
-    bool contains(const QByteArray &a) const { return toLower().contains(a.toLower()); }
+    /// \{
+    static int caseInsensitiveCompare(const QByteArray &a1, const QByteArray &a2) { return caseInsensitiveCompare(a1.constData(), a1.size(), a2.constData(), a2.size()); }
+    static int caseInsensitiveCompare(const QByteArray &a1, const char *a2) { return caseInsensitiveCompare(a1.constData(), a1.size(), a2, qstrlen(a2)); }
+    static int caseInsensitiveCompare(const char *a1, const QByteArray &a2) { return caseInsensitiveCompare(a1, qstrlen(a1), a2.constData(), a2.size()); }
     /// \}
+
+    /**
+     * @brief Compare UTF-8 data with a string without regard to case
+     *
+     * ASCII characters are compared in place - only the data following the
+     * first other character (if any) is converted for the comparison.
+     */
+    static int caseInsensitiveCompare(const QByteArray &a1, const QString &a2);
+
+    /**
+     * @brief Find a string within another without regard to case
+     *
+     * The return value is the index of the first match or -1.
+     */
+    static int caseInsensitiveIndexOf(const char *data, int size, const char *search, int searchSize);
 };
 
-inline bool operator==(const IByteArray &a1, const char *a2) { return a1.toLower() == QByteArray(a2).toLower(); }
-inline bool operator==(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() == a2.toLower(); }
-inline bool operator==(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() == a2.toLower(); }
-inline bool operator==(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() == a2.toLower(); }
-inline bool operator==(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() == a2.toLower(); }
-
-inline bool operator!=(const IByteArray &a1, const char *a2) { return a1.toLower() != QByteArray(a2).toLower(); }
-inline bool operator!=(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() != a2.toLower(); }
-inline bool operator!=(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() != a2.toLower(); }
-inline bool operator!=(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() != a2.toLower(); }
-inline bool operator!=(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() != a2.toLower(); }
-
-inline bool operator<(const IByteArray &a1, const char *a2) { return a1.toLower() < QByteArray(a2).toLower(); }
-inline bool operator<(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() < a2.toLower(); }
-inline bool operator<(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() < a2.toLower(); }
-inline bool operator<(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() < a2.toLower(); }
-inline bool operator<(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() < a2.toLower(); }
-
-inline bool operator>(const IByteArray &a1, const char *a2) { return a1.toLower() > QByteArray(a2).toLower(); }
-inline bool operator>(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() > a2.toLower(); }
-inline bool operator>(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() > a2.toLower(); }
-inline bool operator>(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() > a2.toLower(); }
-inline bool operator>(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() > a2.toLower(); }
-
-inline bool operator<=(const IByteArray &a1, const char *a2) { return a1.toLower() <= QByteArray(a2).toLower(); }
-inline bool operator<=(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() <= a2.toLower(); }
-inline bool operator<=(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() <= a2.toLower(); }
-inline bool operator<=(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() <= a2.toLower(); }
-inline bool operator<=(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() <= a2.toLower(); }
-
-inline bool operator>=(const IByteArray &a1, const char *a2) { return a1.toLower() >= QByteArray(a2).toLower(); }
-inline bool operator>=(const char *a1, const IByteArray &a2) { return QByteArray(a1).toLower() >= a2.toLower(); }
-inline bool operator>=(const IByteArray &a1, const QByteArray &a2) { return a1.toLower() >= a2.toLower(); }
-inline bool operator>=(const QByteArray &a1, const IByteArray &a2) { return a1.toLower() >= a2.toLower(); }
-inline bool operator>=(const IByteArray &a1, const IByteArray &a2) { return a1.toLower() >= a2.toLower(); }
+/**
+ * @brief Hash an IByteArray without regard to case
+ */
+QHTTPENGINE_EXPORT uint qHash(const IByteArray &key, uint seed = 0);
+
+inline bool operator==(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) == 0; }
+inline bool operator==(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) == 0; }
+inline bool operator==(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) == 0; }
+inline bool operator==(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) == 0; }
+inline bool operator==(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) == 0; }
+
+inline bool operator!=(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) != 0; }
+inline bool operator!=(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) != 0; }
+inline bool operator!=(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) != 0; }
+inline bool operator!=(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) != 0; }
+inline bool operator!=(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) != 0; }
+
+inline bool operator<(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) < 0; }
+inline bool operator<(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) < 0; }
+inline bool operator<(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) < 0; }
+inline bool operator<(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) < 0; }
+inline bool operator<(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) < 0; }
+
+inline bool operator>(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) > 0; }
+inline bool operator>(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) > 0; }
+inline bool operator>(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) > 0; }
+inline bool operator>(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) > 0; }
+inline bool operator>(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) > 0; }
+
+inline bool operator<=(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) <= 0; }
+inline bool operator<=(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) <= 0; }
+inline bool operator<=(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) <= 0; }
+inline bool operator<=(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) <= 0; }
+inline bool operator<=(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) <= 0; }
+
+inline bool operator>=(const IByteArray &a1, const char *a2) { return IByteArray::caseInsensitiveCompare(a1, a2) >= 0; }
+inline bool operator>=(const char *a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) >= 0; }
+inline bool operator>=(const IByteArray &a1, const QByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) >= 0; }
+inline bool operator>=(const QByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) >= 0; }
+inline bool operator>=(const IByteArray &a1, const IByteArray &a2) { return IByteArray::caseInsensitiveCompare(a1, a2) >= 0; }
 
 }
 
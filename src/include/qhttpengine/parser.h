@@ -25,6 +25,7 @@
 
 #include <QList>
 
+#include <qhttpengine/headerlist.h>
 #include <qhttpengine/socket.h>
 
 #include "qhttpengine_export.h"
@@ -58,9 +59,28 @@ public:
 
     /**
      * @brief Parse and remove the query string from a path
+     *
+     * This is equivalent to calling decodePath() and parseQueryString().
      */
     static bool parsePath(const QByteArray &rawPath, QString &path, Socket::QueryStringMap &queryString);
 
+    /**
+     * @brief Decode the path from a request path
+     *
+     * The query string and fragment are removed, as are the scheme and
+     * authority of an absolute URI. Percent-encoded characters are decoded
+     * as UTF-8.
+     */
+    static QString decodePath(const QByteArray &rawPath);
+
+    /**
+     * @brief Parse the query string from a request path
+     *
+     * The names and values of the items following the "?" are decoded in the
+     * same way as the path and added to the map in the order they appear.
+     */
+    static void parseQueryString(const QByteArray &rawPath, Socket::QueryStringMap &queryString);
+
     /**
      * @brief Parse a list of lines containing HTTP headers
      *
@@ -83,6 +103,22 @@ public:
      */
     static bool parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, Socket::HeaderMap &headers);
 
+    /**
+     * @brief Parse HTTP request headers
+     *
+     * This overload also provides the HTTP version from the request line
+     * (for example, "HTTP/1.1").
+     */
+    static bool parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, QByteArray &version, Socket::HeaderMap &headers);
+
+    /**
+     * @brief Parse HTTP request headers into a flat list
+     *
+     * The headers are added to the list without creating a separate
+     * QByteArray for each line, which makes this the fastest overload.
+     */
+    static bool parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, QByteArray &version, HeaderList &headers);
+
     /**
      * @brief Parse HTTP response headers
      */
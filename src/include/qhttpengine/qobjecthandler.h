@@ -72,6 +72,10 @@ class QHTTPENGINE_EXPORT QObjectHandlerPrivate;
  *     socket->close();
  * });
  * @endcode
+ *
+ * Slots are always invoked directly on the thread of the socket. If the
+ * server uses worker threads, this is not the thread of the receiver, so
+ * the slot must be safe to invoke from any thread.
  */
 class QHTTPENGINE_EXPORT QObjectHandler : public Handler
 {
@@ -90,7 +94,11 @@ public:
      * This overload uses the traditional connection syntax with macros.
      *
      * The readAll parameter determines whether all data must be received by
-     * the socket before invoking the slot.
+     * the socket before invoking the slot. The body is then held by the
+     * socket - in a temporary file for the most part if it is larger than
+     * the limit set with Server::setBodyBufferSize() - and the slot should
+     * read it from the socket in pieces, rather than with readAll(), so that
+     * a large body is never held in memory at once.
      */
     void registerMethod(const QString &name, QObject *receiver, const char *method, bool readAll = true);
 
@@ -158,6 +166,15 @@ public:
     }
 #endif
 
+    /**
+     * @brief Set the maximum size in bytes of the request body for a method
+     *
+     * This overrides the limit set for the server. A request with a larger
+     * body is rejected with 413 before the slot is invoked. A value of 0
+     * removes the limit.
+     */
+    void setMaxBodySize(const QString &name, qint64 bytes);
+
 protected:
 
     /**
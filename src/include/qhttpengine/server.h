@@ -24,6 +24,7 @@
 #define QHTTPENGINE_SERVER_H
 
 #include <QHostAddress>
+#include <QList>
 #include <QObject>
 #include <QTcpServer>
 
@@ -65,6 +66,47 @@ class QHTTPENGINE_EXPORT ServerPrivate;
  * signal is connected to the [Socket](@ref QHttpEngine::Socket)'s
  * deleteLater() slot to ensure that the socket is deleted when the client
  * disconnects.
+ *
+ * Connections are persistent (HTTP keep-alive) when the client supports it.
+ * Once the response to a request is complete, a new
+ * [Socket](@ref QHttpEngine::Socket) is created for the next request on the
+ * same connection. The number of requests served by a single connection and
+ * the time a connection may remain idle between requests can be limited with
+ * setMaxRequestsPerConnection() and setIdleTimeout().
+ *
+ * Slow or unresponsive clients are disconnected using setHeaderTimeout(),
+ * setBodyTimeout() and setWriteTimeout(). The timeouts for all connections
+ * are tracked together, so they remain cheap with many connections open.
+ *
+ * Clients may also pipeline requests by sending them before the previous
+ * response arrives. Each pipelined request is read and passed to the handler
+ * right away, but responses are always sent in the order that the requests
+ * were received. The number of requests that may be waiting for a response at
+ * the same time can be limited with setMaxPipelinedRequests().
+ *
+ * To stop the server without interrupting requests that are in progress,
+ * call drain() and wait for the drained() signal:
+ *
+ * @code
+ * connect(&server, &QHttpEngine::Server::drained, &app, &QCoreApplication::quit);
+ * server.drain(10000);
+ * @endcode
+ *
+ * A server can also accept connections on a local socket (a Unix domain
+ * socket or a named pipe) with listenLocal(), for example when it sits
+ * behind a reverse proxy on the same machine. These connections are served
+ * by the same handler with the same settings, alongside any TCP connections
+ * or on their own.
+ *
+ * Handlers that are not thread-safe can still make use of several cores by
+ * serving connections in worker processes forked with forkProcesses(). The
+ * process that forks them only supervises them from then on:
+ *
+ * @code
+ * server.listen();
+ * server.forkProcesses(4);
+ * return app.exec();
+ * @endcode
  */
 class QHTTPENGINE_EXPORT Server : public QTcpServer
 {
@@ -72,6 +114,31 @@ class QHTTPENGINE_EXPORT Server : public QTcpServer
 
 public:
 
+    /**
+     * @brief Behavior once the maximum number of connections is reached
+     */
+    enum OverloadPolicy {
+        /// Stop accepting connections until one closes
+        PauseAccepting,
+        /// Respond to new connections with 503 and close them
+        RejectConnections
+    };
+
+    /**
+     * @brief Counters for the connections served by a process
+     */
+    struct ProcessStatistics
+    {
+        /// Process ID
+        qint64 pid;
+        /// Number of requests received
+        qint64 requestCount;
+        /// Number of bytes written to clients
+        qint64 bytesWritten;
+        /// Number of open connections
+        int connectionCount;
+    };
+
     /**
      * @brief Create an HTTP server
      */
@@ -87,6 +154,349 @@ public:
      */
     void setHandler(Handler *handler);
 
+    /**
+     * @brief Set the maximum number of requests served by a connection
+     *
+     * Once a connection has received this many requests, it is closed after
+     * the last response is written. A value of 1 disables persistent
+     * connections and a value of 0 removes the limit. The default is 100.
+     */
+    void setMaxRequestsPerConnection(int maxRequests);
+
+    /**
+     * @brief Set the time in milliseconds a connection may remain idle
+     *
+     * A persistent connection waiting for the next request is closed if no
+     * data arrives within this time. A value of 0 disables the timeout. The
+     * default is 5000 (five seconds).
+     */
+    void setIdleTimeout(int msec);
+
+    /**
+     * @brief Set the time in milliseconds allowed for the request headers
+     *
+     * The time is measured from the first byte of the request. If the
+     * headers are incomplete once it elapses, the connection is closed. A
+     * value of 0 disables the timeout. The default is 10000 (ten seconds).
+     */
+    void setHeaderTimeout(int msec);
+
+    /**
+     * @brief Set the time in milliseconds allowed between parts of a body
+     *
+     * While the body of a request is being received, the connection is
+     * closed if no data arrives within this time. A value of 0 disables the
+     * timeout. The default is 30000 (thirty seconds).
+     */
+    void setBodyTimeout(int msec);
+
+    /**
+     * @brief Set the time in milliseconds a response may stall
+     *
+     * If the client stops receiving the response and none of the pending data
+     * can be written within this time, the connection is closed. A value of 0
+     * disables the timeout. The default is 30000 (thirty seconds).
+     */
+    void setWriteTimeout(int msec);
+
+    /**
+     * @brief Set the maximum number of pipelined requests per connection
+     *
+     * This is the number of requests on a connection that may be waiting for
+     * their response at the same time. Once the limit is reached, no further
+     * data is read from the connection until a response is complete. A value
+     * of 1 disables reading ahead and a value of 0 removes the limit. The
+     * default is 16.
+     */
+    void setMaxPipelinedRequests(int maxPipelinedRequests);
+
+    /**
+     * @brief Set the maximum size in bytes of the request headers
+     *
+     * This includes the request line. A request with larger headers is
+     * rejected with 431 (or 414 if the request line alone is too long) as
+     * soon as the limit is exceeded. A value of 0 removes the limit. The
+     * default is 65536.
+     */
+    void setMaxHeaderSize(int bytes);
+
+    /**
+     * @brief Set the maximum number of request headers
+     *
+     * A request with more headers is rejected with 431. A value of 0 removes
+     * the limit. The default is 100.
+     */
+    void setMaxHeaderCount(int count);
+
+    /**
+     * @brief Set the maximum size in bytes of a request body
+     *
+     * A request with a larger body is rejected with 413 - before the body is
+     * sent if its length is known in advance. Handlers may raise or lower the
+     * limit for individual requests with Socket::setMaxBodySize() while
+     * routing them. A value of 0 removes the limit, which is the default.
+     */
+    void setMaxBodySize(qint64 bytes);
+
+    /**
+     * @brief Set the amount of a request body held in memory
+     *
+     * Once more of the body has been received than the handler has read, the
+     * rest is stored in a temporary file. A value of 0 keeps all of it in
+     * memory. The default is 1048576 (1 MB).
+     */
+    void setBodyBufferSize(qint64 bytes);
+
+    /**
+     * @brief Set whether Nagle's algorithm is disabled for new connections
+     *
+     * When enabled, the TCP_NODELAY option is set on each connection so that
+     * data is sent as soon as it is written. Response headers are already
+     * combined with the start of the body when it is written right away. The
+     * default is false.
+     */
+    void setNoDelay(bool noDelay);
+
+    /**
+     * @brief Set whether connections are corked while writing a response
+     *
+     * When enabled, the TCP_CORK (or TCP_NOPUSH) option is set while a
+     * response is being written and cleared once it is complete, so that
+     * only full segments are sent until the end of the response. This option
+     * has no effect on platforms that do not support it. The default is
+     * false.
+     */
+    void setCorkEnabled(bool corkEnabled);
+
+    /**
+     * @brief Set the HTML template used for error responses
+     *
+     * The template is used by Socket::writeError() for connections accepted
+     * after it is set. The status code, its reason and the version of the
+     * library replace %1, %2 and %3 respectively. The response for each of
+     * the predefined error status codes is rendered once when the template
+     * is set rather than each time it is written. An empty template
+     * restores the default.
+     */
+    void setErrorTemplate(const QString &errorTemplate);
+
+    /**
+     * @brief Set the number of connections kept for reuse
+     *
+     * Rather than destroying the objects used for a connection once the
+     * client disconnects, up to this many are reset and reused for new
+     * clients. This does not apply to encrypted connections. A connection is
+     * only reused once every [Socket](@ref QHttpEngine::Socket) created for
+     * it was destroyed. A value of 0 disables reuse. The default is 64.
+     */
+    void setConnectionPoolSize(int size);
+
+    /**
+     * @brief Set the number of threads used to serve connections
+     *
+     * By default, connections are served on the thread of the server. With
+     * worker threads, the server only accepts connections on its own thread
+     * and hands each of them to the worker thread with the fewest
+     * connections. Everything created for the connection - including each
+     * [Socket](@ref QHttpEngine::Socket) and the handlers' objects created
+     * for it - lives on that thread. See [Handler](@ref QHttpEngine::Handler)
+     * for the requirements this places on handlers.
+     *
+     * When worker threads are used, neither this nor any other setting of
+     * the server may be changed after listen() is called. A value of 0
+     * serves connections on the thread of the server, which is the default.
+     */
+    void setWorkerThreadCount(int count);
+
+    /**
+     * @brief Listen with a separate socket for each worker thread
+     *
+     * Rather than accepting every connection on the thread of the server,
+     * each worker thread opens its own socket on the same address and port
+     * with SO_REUSEPORT and accepts connections on it, so that the system
+     * spreads incoming connections across the threads. The worker threads
+     * are set with setWorkerThreadCount() beforehand. If port is 0, a
+     * port is chosen automatically and can be retrieved with serverPort().
+     *
+     * The limit set with setMaxConnections() is divided evenly between the
+     * sockets and connections waiting for a free slot are not included in
+     * waitingConnectionCount(). The sockets of the worker threads are closed
+     * by drain() and when the server is destroyed but not by close().
+     *
+     * This returns false if the socket could not be opened or if the
+     * platform does not support SO_REUSEPORT.
+     */
+    bool listenReusePort(const QHostAddress &address = QHostAddress::Any, quint16 port = 0);
+
+    /**
+     * @brief Listen for connections on a local socket
+     *
+     * The name is interpreted as by QLocalServer::listen() - on Unix, it is
+     * either the path of a Unix domain socket or a name for one in the
+     * temporary directory. Connections on the local socket count toward the
+     * same limits as TCP connections and are stopped by drain(). They are
+     * never encrypted and [Socket](@ref QHttpEngine::Socket)::peerAddress()
+     * returns a null address for them.
+     *
+     * This returns false if the server could not listen on the socket or
+     * forked worker processes, which cannot share a local socket.
+     */
+    bool listenLocal(const QString &name);
+
+    /**
+     * @brief Retrieve the full name of the local socket
+     *
+     * This is empty unless listenLocal() succeeded.
+     */
+    QString localServerName() const;
+
+    /**
+     * @brief Serve connections in the specified number of worker processes
+     *
+     * The worker processes are copies of the current process at the time of
+     * the call, which then acts as their supervisor - it stops accepting
+     * connections and has a replacement started for any worker process that
+     * crashes (one that exits normally is not replaced). Replacements are
+     * copies of the process at the same point as the initial worker
+     * processes. Each worker process inherits the listening socket along
+     * with the handler and settings of the server and accepts connections
+     * from it on its own.
+     *
+     * This must be called after listen() but before the event loop is
+     * started with QCoreApplication::exec() and before worker threads or
+     * any other threads are started, since threads do not survive in the
+     * forked processes and the state of a running event loop must not be
+     * shared with them. The function returns in the supervisor and in each
+     * worker process - use isSupervisor() to tell them apart.
+     *
+     * Calling drain() in the supervisor drains every worker process and
+     * drained() is emitted once they have all exited - any that remain at
+     * the deadline are killed. A worker process drains by itself when the
+     * supervisor is destroyed or dies and leaves its event loop with
+     * QCoreApplication::quit() once it is drained.
+     *
+     * This returns false if the server is not listening with listen(),
+     * uses worker threads, listens on a local socket or already forked
+     * worker processes, if it is called while an event loop is running or
+     * if the platform does not support fork().
+     */
+    bool forkProcesses(int count);
+
+    /**
+     * @brief Determine whether this process supervises worker processes
+     */
+    bool isSupervisor() const;
+
+    /**
+     * @brief Pass the listening socket on to a new process
+     *
+     * This connects to the Unix domain socket at path - which a new process
+     * created with adoptListeningDescriptor() - and sends the listening
+     * socket through it. If idleConnections is true, connections that are
+     * waiting for their next request are sent as well, so that their
+     * clients carry on with the new process. Encrypted connections are
+     * never sent.
+     *
+     * Once the socket is sent, the server drains as if drain() had been
+     * called - the remaining connections are finished here while the new
+     * process accepts the new ones. No connection is refused in between.
+     *
+     * This returns false if the server is not listening with listen() -
+     * which includes listening with listenReusePort() - or if the socket
+     * could not be sent, in which case the server continues
+     * as before. It is only supported on Unix.
+     */
+    bool handOver(const QString &path, bool idleConnections = false);
+
+    /**
+     * @brief Listen on a socket passed on by another process
+     *
+     * This creates a Unix domain socket at path and waits up to msec
+     * milliseconds for a server in another process to call handOver() with
+     * it. The server then listens on the same socket as the other process,
+     * without it ever being closed, and serves any connections that were
+     * passed along with it. Worker threads and other settings should be set
+     * beforehand. This blocks until the other process has passed on
+     * everything and returns false if no listening socket was received.
+     *
+     * A socket left at path by an earlier attempt is replaced, but anything
+     * else there causes this to fail. Only a process running as the same
+     * user may pass on its socket.
+     */
+    bool adoptListeningDescriptor(const QString &path, int msec = 30000);
+
+    /**
+     * @brief Set the maximum number of open connections
+     *
+     * This includes encrypted connections that are still being negotiated.
+     * What happens to connections beyond the limit is determined by
+     * setOverloadPolicy(). A value of 0 removes the limit, which is the
+     * default.
+     */
+    void setMaxConnections(int count);
+
+    /**
+     * @brief Set what happens to connections beyond the limit
+     *
+     * With PauseAccepting, new connections are left in the backlog of the
+     * listening socket until a connection closes. Connections that the
+     * system already handed over at that point wait for a free slot without
+     * being read from. With RejectConnections, a 503 response is sent to
+     * the client as soon as it connects and it is disconnected shortly after
+     * (encrypted connections are disconnected right away). Only a limited
+     * number of rejected connections are kept open at once - any others are
+     * disconnected without a response. The default is PauseAccepting.
+     */
+    void setOverloadPolicy(OverloadPolicy policy);
+
+    /**
+     * @brief Retrieve the number of open connections
+     */
+    int connectionCount() const;
+
+    /**
+     * @brief Retrieve the number of connections waiting for a free slot
+     */
+    int waitingConnectionCount() const;
+
+    /**
+     * @brief Retrieve the number of connections rejected so far
+     */
+    qint64 rejectedConnectionCount() const;
+
+    /**
+     * @brief Retrieve the counters for each process serving connections
+     *
+     * With worker processes, this includes every worker process that is
+     * running and may be called from any of them (or from the supervisor) -
+     * the counters are kept in memory shared between the processes. The
+     * counters of a worker process that crashed are carried over to its
+     * replacement. Otherwise, the list contains the counters of the current
+     * process only.
+     */
+    QList<ProcessStatistics> processStatistics() const;
+
+    /**
+     * @brief Stop the server once the requests in progress are complete
+     *
+     * The server stops listening for new connections right away. Idle
+     * connections are closed, no further requests are read from the others
+     * and each of them is closed once the responses to the requests already
+     * received are written. The drained() signal is emitted once every
+     * client has disconnected or, if msec is greater than 0, once that many
+     * milliseconds have passed - any connections that remain at that point
+     * are aborted.
+     */
+    void drain(int msec = 30000);
+
+    /**
+     * @brief Determine whether the server is draining
+     *
+     * This is true from the time drain() is called until drained() is
+     * emitted.
+     */
+    bool isDraining() const;
+
 #if !defined(QT_NO_SSL)
     /**
      * @brief Set the SSL configuration for the server
@@ -97,6 +507,16 @@ public:
     void setSslConfiguration(const QSslConfiguration &configuration);
 #endif
 
+Q_SIGNALS:
+
+    /**
+     * @brief Indicate that the server finished draining
+     *
+     * This signal is emitted once all of the connections are closed after
+     * drain() was called, or once the deadline passed.
+     */
+    void drained();
+
 protected:
 
     /**
@@ -27,16 +27,18 @@
 #include <QIODevice>
 #include <QMultiMap>
 
+#include <qhttpengine/headerlist.h>
 #include <qhttpengine/ibytearray.h>
 
 #include "qhttpengine_export.h"
 
 class QJsonDocument;
-class QTcpSocket;
 
 namespace QHttpEngine
 {
 
+class Connection;
+
 class QHTTPENGINE_EXPORT SocketPrivate;
 
 /**
@@ -46,7 +48,8 @@ class QHTTPENGINE_EXPORT SocketPrivate;
  * data from and write data to an HTTP client through a QTcpSocket provided in
  * the constructor. The socket will assume ownership of the QTcpSocket and
  * ensure it is properly deleted. Consequently, the QTcpSocket must have been
- * allocated on the heap:
+ * allocated on the heap. A QLocalSocket or any other open, sequential
+ * QIODevice can be used in the same way:
  *
  * @code
  * QTcpSocket *tcpSock = new QTcpSocket;
@@ -71,10 +74,33 @@ class QHTTPENGINE_EXPORT SocketPrivate;
  * }
  * @endcode
  *
+ * To avoid copying the body, it can instead be processed in the pieces that
+ * it arrived in using peekSegment(), readSegment() and consume():
+ *
+ * @code
+ * for (QByteArray data = httpSock->readSegment(); data.size(); data = httpSock->readSegment()) {
+ *     hash.addData(data);
+ * }
+ * @endcode
+ *
  * If the client sets the `Content-Length` header, the readChannelFinished()
  * signal will be emitted when the specified amount of data is read from the
- * client. Otherwise the readChannelFinished() signal will be emitted
- * immediately after the headers are read.
+ * client. A request body sent with chunked transfer encoding is decoded as it
+ * arrives and readChannelFinished() is emitted once the last chunk is read.
+ * Otherwise the readChannelFinished() signal will be emitted immediately
+ * after the headers are read.
+ *
+ * Data that the handler has not read yet is held in memory until it exceeds
+ * a limit set for the server, after which it is stored in a temporary file.
+ * Reading from the socket returns the data in the order it was received in
+ * either case, so the size of the request body does not affect memory use.
+ *
+ * A client that sends the `Expect: 100-continue` header waits for permission
+ * before sending the body. This is given once the handlers connected to
+ * headersParsed() return, unless one of them already wrote a response. A
+ * request can therefore be rejected (for example, with 401 or 413) without
+ * the body ever being transmitted. The connection is closed after such a
+ * response.
  *
  * The status code and headers may be set as long as no data has been written
  * to the device and the writeHeaders() method has not been called. The
@@ -87,11 +113,37 @@ class QHTTPENGINE_EXPORT SocketPrivate;
  * httpSock->write("Hello, world!");
  * @endcode
  *
+ * The response to a HEAD request never includes a body. Data written after
+ * the headers is discarded, so a handler may treat HEAD the same as GET -
+ * although it can avoid producing the body at all by checking method().
+ *
  * This class also provides methods that simplify writing a redirect or an
  * HTTP error to the socket. To write a redirect, simply pass a path to the
  * writeRedirect() method. To write an error, simply pass the desired HTTP
  * status code to the writeError() method. Both methods will close the socket
  * once the response is written.
+ *
+ * When created by a [Server](@ref QHttpEngine::Server), each socket
+ * represents a single request. If the client supports persistent
+ * connections, closing the socket leaves the underlying device open so
+ * that the server can read the next request from it. A response without a
+ * `Content-Length` header is then sent to HTTP/1.1 clients using chunked
+ * transfer encoding, allowing the body to be streamed without knowing its
+ * length in advance.
+ *
+ * Data written to the socket is buffered until the client receives it. To
+ * avoid buffering a large response in memory when the client is slow, check
+ * canWrite() before writing more and wait for the writeBufferDrained() signal
+ * when it returns false:
+ *
+ * @code
+ * void MyClass::writeMore()
+ * {
+ *     while (httpSock->canWrite() && hasMoreData()) {
+ *         httpSock->write(nextData());
+ *     }
+ * }
+ * @endcode
  */
 class QHTTPENGINE_EXPORT Socket : public QIODevice
 {
@@ -142,18 +194,24 @@ public:
      * Predefined constants for HTTP status codes
      */
     enum {
+        /// Client may send the request body
+        Continue = 100,
         /// Request was successful
         OK = 200,
         /// Request was successful and a resource was created
         Created = 201,
         /// Request was accepted for processing, not completed yet.
         Accepted = 202,
+        /// Request was successful and there is no content to return
+        NoContent = 204,
         /// %Range request was successful
         PartialContent = 206,
         /// Resource has moved permanently
         MovedPermanently = 301,
         /// Resource is available at an alternate URI
         Found = 302,
+        /// Resource has not been modified since it was last requested
+        NotModified = 304,
         /// Bad client request
         BadRequest = 400,
         /// Client is unauthorized to access the resource
@@ -166,8 +224,18 @@ public:
         MethodNotAllowed = 405,
         /// The request could not be completed due to a conflict with the current state of the resource
         Conflict = 409,
+        /// The request body is larger than the server is willing to receive
+        PayloadTooLarge = 413,
+        /// The request URI is longer than the server is willing to interpret
+        UriTooLong = 414,
+        /// The expectation in the request cannot be met
+        ExpectationFailed = 417,
+        /// The request headers are too large
+        RequestHeaderFieldsTooLarge = 431,
         /// An internal server error occurred
         InternalServerError = 500,
+        /// The request uses a feature the server does not support
+        NotImplemented = 501,
         /// Invalid response from server while acting as a gateway
         BadGateway = 502,
         /// %Server unable to handle request due to overload
@@ -177,12 +245,14 @@ public:
     };
 
     /**
-     * @brief Create a new socket from a QTcpSocket
+     * @brief Create a new socket from a QTcpSocket or other device
      *
-     * This instance will assume ownership of the QTcpSocket. That is, it will
-     * make itself the parent of the socket.
+     * This instance will assume ownership of the device. That is, it will
+     * make itself the parent of the device. For a device other than a
+     * QTcpSocket or QLocalSocket, the client is considered disconnected once
+     * the device is closed.
      */
-    Socket(QTcpSocket *socket, QObject *parent = 0);
+    Socket(QIODevice *socket, QObject *parent = 0);
 
     /**
      * @brief Retrieve the number of bytes available for reading
@@ -192,6 +262,31 @@ public:
      */
     virtual qint64 bytesAvailable() const;
 
+    /**
+     * @brief Retrieve the next part of the request body without removing it
+     *
+     * The data is shared with the buffer of the socket rather than copied,
+     * unless the body is too large to be held in memory. The size of each
+     * part depends on how the data arrived. An empty QByteArray is returned
+     * if no data is available. Use consume() to remove the data once it was
+     * processed.
+     */
+    QByteArray peekSegment();
+
+    /**
+     * @brief Read the next part of the request body
+     *
+     * This is equivalent to calling peekSegment() followed by consume().
+     */
+    QByteArray readSegment();
+
+    /**
+     * @brief Remove data from the start of the request body
+     *
+     * The return value is the number of bytes that were removed.
+     */
+    qint64 consume(qint64 len);
+
     /**
      * @brief Determine if the device is sequential
      *
@@ -199,17 +294,46 @@ public:
      */
     virtual bool isSequential() const;
 
+    /**
+     * @brief Retrieve the number of bytes waiting to be written
+     *
+     * This includes the response headers and any data that has been written
+     * to the device but not yet sent to the client.
+     */
+    virtual qint64 bytesToWrite() const;
+
+    /**
+     * @brief Set the high and low watermarks for the write buffer
+     *
+     * Once the number of bytes waiting to be written reaches the high
+     * watermark, canWrite() returns false until it drops to the low
+     * watermark, at which point writeBufferDrained() is emitted. A high
+     * watermark of 0 disables the limit. The defaults are 262144 and 65536.
+     */
+    void setWriteWatermarks(qint64 high, qint64 low);
+
+    /**
+     * @brief Determine if more data should be written
+     *
+     * Writing is still possible when this method returns false, but the data
+     * will be buffered in memory until the client is able to receive it.
+     */
+    bool canWrite() const;
+
     /**
      * @brief Close the device and underlying socket
      *
      * Invoking this method signifies that no more data will be written to the
-     * device. It will also close the underlying QTcpSocket and destroy this
+     * device. It will also close the underlying device (unless the
+     * connection is being kept alive for another request) and destroy this
      * object.
      */
     virtual void close();
 
     /**
      * @brief Retrive the address of the remote peer
+     *
+     * This is a null address unless the client is connected over TCP.
      */
     QHostAddress peerAddress() const;
 
@@ -218,6 +342,14 @@ public:
      */
     bool isHeadersParsed() const;
 
+    /**
+     * @brief Determine if the entire request body has been received
+     *
+     * Once this is the case, the readChannelFinished() signal has already
+     * been emitted and will not be emitted again for the request.
+     */
+    bool isReadFinished() const;
+
     /**
      * @brief Retrieve the request method
      *
@@ -256,9 +388,43 @@ public:
      * This method may only be called after the request headers have been
      * parsed. The original case of the headers is preserved but comparisons
      * are performed in a case-insensitive manner.
+     *
+     * The map is created from the list of headers the first time this method
+     * is called. Use header() to look up individual headers instead.
      */
     HeaderMap headers() const;
 
+    /**
+     * @brief Retrieve the list of request headers
+     *
+     * The headers are listed in the order they were received.
+     */
+    const HeaderList &headerList() const;
+
+    /**
+     * @brief Retrieve the value of a well-known request header
+     *
+     * This lookup takes constant time. A null QByteArray is returned if the
+     * header is not present.
+     */
+    QByteArray header(HeaderList::Id id) const;
+
+    /**
+     * @brief Retrieve the value of a request header
+     */
+    QByteArray header(const QByteArray &name) const;
+
+    /**
+     * @brief Set the maximum size in bytes of the request body
+     *
+     * This overrides the limit set for the server and is usually called by
+     * a handler once it knows which resource is requested. If the body is
+     * already known to be larger, 413 is written to the socket and it is
+     * closed - otherwise, this happens as soon as the limit is exceeded. A
+     * value of 0 removes the limit.
+     */
+    void setMaxBodySize(qint64 bytes);
+
     /**
      * @brief Retrieve the length of the content
      *
@@ -326,6 +492,9 @@ public:
 
     /**
      * @brief Write an HTTP error to the socket and close it
+     *
+     * The body is an HTML page describing the error, rendered from the
+     * template set with Server::setErrorTemplate().
      */
     void writeError(int statusCode, const QByteArray &statusReason = QByteArray());
 
@@ -351,6 +520,14 @@ Q_SIGNALS:
      */
     void disconnected();
 
+    /**
+     * @brief Indicate that the write buffer has drained
+     *
+     * This signal is emitted once the number of bytes waiting to be written
+     * drops to the low watermark after canWrite() returned false.
+     */
+    void writeBufferDrained();
+
 protected:
 
     /**
@@ -365,8 +542,11 @@ protected:
 
 private:
 
+    Socket(Connection *connection, QObject *parent);
+
     SocketPrivate *const d;
     friend class SocketPrivate;
+    friend class Connection;
 };
 
 }
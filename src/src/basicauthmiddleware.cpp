@@ -54,7 +54,7 @@ bool BasicAuthMiddleware::verify(const QString &username, const QString &passwor
 bool BasicAuthMiddleware::process(Socket *socket)
 {
     // Attempt to extract credentials from the header
-    QByteArrayList headerParts = socket->headers().value("Authorization").split(' ');
+    QByteArrayList headerParts = socket->header(HeaderList::Authorization).split(' ');
     if (headerParts.count() == 2 && headerParts.at(0) == IByteArray("Basic")) {
 
         // Decode the credentials and split into username/password
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QTemporaryFile>
+
+#include "bodybuffer.h"
+
+using namespace QHttpEngine;
+
+// Amount of data read from the file at once by peek()
+const qint64 PeekSize = 65536;
+
+BodyBuffer::BodyBuffer()
+    : maxMemorySize(0),
+      file(0),
+      fileReadPos(0),
+      fileSize(0),
+      fileFailed(false),
+      readFailed(false)
+{
+}
+
+BodyBuffer::~BodyBuffer()
+{
+    delete file;
+}
+
+void BodyBuffer::setMaxMemorySize(qint64 maxMemorySize)
+{
+    this->maxMemorySize = maxMemorySize;
+}
+
+qint64 BodyBuffer::size() const
+{
+    return fileSize - fileReadPos + memory.size();
+}
+
+bool BodyBuffer::isEmpty() const
+{
+    return !size();
+}
+
+void BodyBuffer::append(const QByteArray &data)
+{
+    memory.append(data);
+    if (maxMemorySize > 0 && memory.size() > maxMemorySize && !fileFailed) {
+        spill();
+    }
+}
+
+void BodyBuffer::append(const char *data, qint64 len)
+{
+    if (len > 0) {
+        append(QByteArray(data, len));
+    }
+}
+
+QByteArray BodyBuffer::peek()
+{
+    // Data in the file must be copied - it is only removed by skip()
+    if (fileSize > fileReadPos) {
+        QByteArray data(qMin(fileSize - fileReadPos, PeekSize), Qt::Uninitialized);
+        qint64 size = -1;
+        if (file->seek(fileReadPos)) {
+            size = file->read(data.data(), data.size());
+        }
+        if (size <= 0) {
+            fail();
+            return QByteArray();
+        }
+        data.resize(size);
+        return data;
+    }
+
+    return memory.peek();
+}
+
+qint64 BodyBuffer::skip(qint64 maxlen)
+{
+    qint64 size = 0;
+
+    if (fileSize > fileReadPos && maxlen > 0) {
+        size = qMin(maxlen, fileSize - fileReadPos);
+        fileReadPos += size;
+        if (fileReadPos == fileSize) {
+            file->resize(0);
+            fileReadPos = fileSize = 0;
+        }
+    }
+
+    return size + memory.skip(maxlen - size);
+}
+
+qint64 BodyBuffer::read(char *data, qint64 maxlen)
+{
+    qint64 size = 0;
+
+    // Data in the file was appended before the data in memory
+    if (fileSize > fileReadPos && maxlen > 0) {
+        size = -1;
+        if (file->seek(fileReadPos)) {
+            size = file->read(data, qMin(maxlen, fileSize - fileReadPos));
+        }
+        if (size <= 0) {
+            fail();
+            return -1;
+        }
+        fileReadPos += size;
+
+        // Once the file is empty, it can be reused from the beginning
+        if (fileReadPos == fileSize) {
+            file->resize(0);
+            fileReadPos = fileSize = 0;
+        } else {
+            return size;
+        }
+    }
+
+    return size + memory.read(data + size, maxlen - size);
+}
+
+QByteArray BodyBuffer::read(qint64 maxlen)
+{
+    // Data in memory can be shared rather than copied
+    if (fileSize == fileReadPos) {
+        return memory.read(maxlen);
+    }
+
+    QByteArray data(qMin(size(), maxlen), Qt::Uninitialized);
+    data.resize(qMax(read(data.data(), data.size()), Q_INT64_C(0)));
+    return data;
+}
+
+QByteArray BodyBuffer::readAll()
+{
+    return read(size());
+}
+
+void BodyBuffer::clear()
+{
+    memory.clear();
+    delete file;
+    file = 0;
+    fileReadPos = fileSize = 0;
+    fileFailed = false;
+    readFailed = false;
+}
+
+bool BodyBuffer::hasReadError() const
+{
+    return readFailed;
+}
+
+void BodyBuffer::spill()
+{
+    if (!file) {
+        file = new QTemporaryFile;
+        if (!file->open()) {
+            delete file;
+            file = 0;
+            fileFailed = true;
+            return;
+        }
+    }
+
+    // Move everything in memory to the end of the file - if it cannot be
+    // written in full, the data remains in memory instead
+    if (!file->seek(fileSize)) {
+        fileFailed = true;
+        return;
+    }
+    QByteArray data = memory.readAll();
+    qint64 written = file->write(data);
+    if (written != data.size()) {
+        file->resize(fileSize);
+        memory.append(data);
+        fileFailed = true;
+        return;
+    }
+    fileSize += written;
+}
+
+void BodyBuffer::fail()
+{
+    // The data in memory follows the data that was lost, so it is dropped as
+    // well and nothing more is written to the file
+    memory.clear();
+    delete file;
+    file = 0;
+    fileReadPos = fileSize = 0;
+    fileFailed = true;
+    readFailed = true;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_BODYBUFFER_H
+#define QHTTPENGINE_BODYBUFFER_H
+
+#include <QByteArray>
+
+#include "segmentedbuffer.h"
+
+class QTemporaryFile;
+
+namespace QHttpEngine
+{
+
+/**
+ * @brief Buffer for a request body that overflows to a temporary file
+ *
+ * Data is appended to the end of the buffer and consumed from the front,
+ * just like SegmentedBuffer. Once more than the maximum amount of data is
+ * held in memory, it is moved to a temporary file and the data that arrives
+ * after it is collected in memory and moved to the file in the same way. The
+ * file is always read before the data in memory, so the order of the data is
+ * preserved. If the file cannot be created or written, the data remains in
+ * memory and no further attempt is made until the buffer is cleared. If the
+ * file cannot be read back, all of the data is dropped and hasReadError()
+ * returns true, since nothing after the missing data is of any use.
+ */
+class BodyBuffer
+{
+public:
+
+    BodyBuffer();
+    ~BodyBuffer();
+
+    void setMaxMemorySize(qint64 maxMemorySize);
+
+    qint64 size() const;
+    bool isEmpty() const;
+
+    void append(const QByteArray &data);
+    void append(const char *data, qint64 len);
+
+    QByteArray peek();
+    qint64 skip(qint64 maxlen);
+
+    qint64 read(char *data, qint64 maxlen);
+    QByteArray read(qint64 maxlen);
+    QByteArray readAll();
+
+    void clear();
+
+    bool hasReadError() const;
+
+private:
+
+    Q_DISABLE_COPY(BodyBuffer)
+
+    void spill();
+    void fail();
+
+    SegmentedBuffer memory;
+    qint64 maxMemorySize;
+
+    // Temporary file with the data that precedes the data in memory along
+    // with the position of the next byte to read and the end of the data
+    QTemporaryFile *file;
+    qint64 fileReadPos;
+    qint64 fileSize;
+
+    // Whether the file could not be created or written and whether it could
+    // not be read back
+    bool fileFailed;
+    bool readFailed;
+};
+
+}
+
+#endif // QHTTPENGINE_BODYBUFFER_H
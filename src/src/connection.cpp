@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QAbstractSocket>
+#include <QLocalSocket>
+#include <QTimer>
+
+#if defined(Q_OS_UNIX)
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/socket.h>
+#endif
+
+#include <qhttpengine/socket.h>
+
+#include "connection.h"
+#include "counters.h"
+#include "socket_p.h"
+
+using namespace QHttpEngine;
+
+Connection::Connection(QIODevice *socket, QObject *parent)
+    : QObject(parent),
+      socket(socket),
+      tcpSocket(qobject_cast<QAbstractSocket*>(socket)),
+      localSocket(qobject_cast<QLocalSocket*>(socket)),
+      requestCount(0),
+      liveSockets(0),
+      maxRequests(1),
+      maxPipelinedRequests(1),
+      headerSizeLimit(DefaultMaxHeaderSize),
+      headerCountLimit(DefaultMaxHeaderCount),
+      bodySizeLimit(0),
+      bodyBufferLimit(DefaultBodyBufferSize),
+      corkEnabled(false),
+      corked(false),
+      closing(false),
+      draining(false),
+      counters(0),
+      timerWheel(0),
+      idleTimeout(0),
+      headerTimeout(0),
+      bodyTimeout(0),
+      writeTimeout(0),
+      readTimer([this]() { onReadTimeout(); }),
+      writeTimer([this]() { onWriteTimeout(); })
+{
+    socket->setParent(this);
+
+    connect(socket, &QIODevice::readyRead, this, &Connection::onReadyRead);
+    connect(socket, &QIODevice::bytesWritten, this, &Connection::onBytesWritten);
+
+    // Other devices have no disconnected() signal and are done with once
+    // closed - they are still open while aboutToClose() is emitted
+    if (tcpSocket) {
+        connect(tcpSocket, &QAbstractSocket::disconnected, this, &Connection::onDisconnected);
+    } else if (localSocket) {
+        connect(localSocket, &QLocalSocket::disconnected, this, &Connection::onDisconnected);
+    } else {
+        connect(socket, &QIODevice::aboutToClose, this, &Connection::onDisconnected, Qt::QueuedConnection);
+    }
+}
+
+void Connection::setMaxRequests(int maxRequests)
+{
+    this->maxRequests = maxRequests;
+}
+
+void Connection::setMaxPipelinedRequests(int maxPipelinedRequests)
+{
+    this->maxPipelinedRequests = maxPipelinedRequests;
+}
+
+void Connection::setTimerWheel(TimerWheel *timerWheel)
+{
+    this->timerWheel = timerWheel;
+}
+
+void Connection::setIdleTimeout(int idleTimeout)
+{
+    this->idleTimeout = idleTimeout;
+}
+
+void Connection::setHeaderTimeout(int headerTimeout)
+{
+    this->headerTimeout = headerTimeout;
+}
+
+void Connection::setBodyTimeout(int bodyTimeout)
+{
+    this->bodyTimeout = bodyTimeout;
+}
+
+void Connection::setWriteTimeout(int writeTimeout)
+{
+    this->writeTimeout = writeTimeout;
+}
+
+void Connection::setMaxHeaderSize(int maxHeaderSize)
+{
+    headerSizeLimit = maxHeaderSize;
+}
+
+void Connection::setMaxHeaderCount(int maxHeaderCount)
+{
+    headerCountLimit = maxHeaderCount;
+}
+
+void Connection::setMaxBodySize(qint64 maxBodySize)
+{
+    bodySizeLimit = maxBodySize;
+}
+
+void Connection::setBodyBufferSize(qint64 bodyBufferSize)
+{
+    bodyBufferLimit = bodyBufferSize;
+}
+
+void Connection::setCorkEnabled(bool corkEnabled)
+{
+    this->corkEnabled = corkEnabled;
+}
+
+void Connection::setErrorPages(const QSharedPointer<const ErrorPages> &errorPages)
+{
+    customErrorPages = errorPages;
+}
+
+void Connection::setCounters(Counters *counters)
+{
+    this->counters = counters;
+}
+
+int Connection::maxHeaderSize() const
+{
+    return headerSizeLimit;
+}
+
+int Connection::maxHeaderCount() const
+{
+    return headerCountLimit;
+}
+
+qint64 Connection::maxBodySize() const
+{
+    return bodySizeLimit;
+}
+
+qint64 Connection::bodyBufferSize() const
+{
+    return bodyBufferLimit;
+}
+
+const ErrorPages *Connection::errorPages() const
+{
+    return customErrorPages ? customErrorPages.data() : ErrorPages::defaultPages();
+}
+
+void Connection::start(Socket *httpSocket)
+{
+    // If a socket was provided, it receives the first request - otherwise a
+    // new socket is created as soon as data arrives
+    if (httpSocket) {
+        sockets.append(httpSocket);
+        ++requestCount;
+    } else {
+        readTimer.start(timerWheel, idleTimeout);
+    }
+
+    // Process anything already received by the socket
+    onReadyRead();
+}
+
+void Connection::reset()
+{
+    readTimer.stop();
+    writeTimer.stop();
+
+    readBuffer.clear();
+    sockets.clear();
+    pendingWrites.clear();
+
+    requestCount = 0;
+    corked = false;
+    closing = false;
+    draining = false;
+}
+
+void Connection::drain()
+{
+    draining = true;
+
+    // A connection waiting for the next request can be closed right away
+    if (sockets.isEmpty()) {
+        close();
+        return;
+    }
+
+    // Otherwise the last response lets the client know that the connection
+    // will be closed - unless its headers were already written, in which
+    // case the connection is closed once it is complete
+    Socket *httpSocket = sockets.last();
+    if (httpSocket->d->writeState == SocketPrivate::WriteNone) {
+        httpSocket->d->keepAlive = false;
+    }
+}
+
+int Connection::socketCount() const
+{
+    return liveSockets;
+}
+
+bool Connection::isKeepAliveAllowed() const
+{
+    return !draining && (maxRequests <= 0 || requestCount < maxRequests);
+}
+
+bool Connection::isIdle() const
+{
+    // Nothing may be in progress in either direction and nothing of the next
+    // request may have been read yet
+    return !closing && sockets.isEmpty() && pendingWrites.isEmpty() &&
+            readBuffer.isEmpty() && !socket->bytesAvailable() && !socket->bytesToWrite() &&
+            isConnected();
+}
+
+bool Connection::isConnected() const
+{
+    if (tcpSocket) {
+        return tcpSocket->state() == QAbstractSocket::ConnectedState;
+    } else if (localSocket) {
+        return localSocket->state() == QLocalSocket::ConnectedState;
+    }
+    return socket->isOpen();
+}
+
+bool Connection::isDisconnected() const
+{
+    if (tcpSocket) {
+        return tcpSocket->state() == QAbstractSocket::UnconnectedState;
+    } else if (localSocket) {
+        return localSocket->state() == QLocalSocket::UnconnectedState;
+    }
+    return !socket->isOpen();
+}
+
+qint64 Connection::write(Socket *httpSocket, const char *data, qint64 len)
+{
+    int index = sockets.indexOf(httpSocket);
+    if (index == -1) {
+        return -1;
+    }
+
+    // Responses must be sent in the order that the requests were received,
+    // so hold on to the data until the responses before it are complete -
+    // the socket counts it as pending like any other data it wrote
+    if (index > 0) {
+        httpSocket->d->writeBuffer.append(data, len);
+        return len;
+    }
+
+    // Hold back partial segments until the response is complete
+    if (corkEnabled && !corked && tcpSocket) {
+        setCorked(true);
+    }
+
+    qint64 written = socket->write(data, len);
+
+    // Give up if the client stops receiving the response
+    if (socket->bytesToWrite() && !writeTimer.isActive()) {
+        writeTimer.start(timerWheel, writeTimeout);
+    }
+
+    // Remember which socket the data belongs to so that bytesWritten() can
+    // later be emitted by the correct socket
+    if (written > 0) {
+        if (pendingWrites.count() && pendingWrites.last().first == httpSocket) {
+            pendingWrites.last().second += written;
+        } else {
+            pendingWrites.append(qMakePair(QPointer<Socket>(httpSocket), written));
+        }
+    }
+
+    return written;
+}
+
+void Connection::finish(Socket *httpSocket)
+{
+    // A socket that is not at the front of the queue is completed once the
+    // responses before it have been written
+    if (sockets.count() && sockets.first() == httpSocket) {
+        writeResponses();
+    }
+}
+
+void Connection::close()
+{
+    closing = true;
+    readTimer.stop();
+    writeTimer.stop();
+    socket->close();
+}
+
+void Connection::abort()
+{
+    // Discard anything not yet written instead of waiting for it
+    closing = true;
+    readTimer.stop();
+    writeTimer.stop();
+
+    if (tcpSocket) {
+        tcpSocket->abort();
+    } else if (localSocket) {
+        localSocket->abort();
+    } else {
+        socket->close();
+    }
+}
+
+bool Connection::isAccepting() const
+{
+    // Another request can only be read if the last one allows the connection
+    // to be reused and the limit for pipelined requests was not reached
+    if (closing || !socket->isOpen() || !isKeepAliveAllowed()) {
+        return false;
+    }
+    if (sockets.count()) {
+        return sockets.last()->d->keepAlive &&
+                (maxPipelinedRequests <= 0 || sockets.count() < maxPipelinedRequests);
+    }
+    return true;
+}
+
+Socket *Connection::reader() const
+{
+    if (sockets.count() && sockets.last()->d->readState != SocketPrivate::ReadFinished) {
+        return sockets.last();
+    }
+    return 0;
+}
+
+void Connection::readSocket()
+{
+    // Assigning to an empty buffer shares the data instead of copying it
+    if (readBuffer.isEmpty()) {
+        readBuffer = socket->readAll();
+    } else {
+        readBuffer.append(socket->readAll());
+    }
+}
+
+void Connection::setCorked(bool corked)
+{
+    this->corked = corked;
+
+    int value = corked ? 1 : 0;
+#if defined(TCP_CORK)
+    setsockopt(tcpSocket->socketDescriptor(), IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+#elif defined(TCP_NOPUSH)
+    setsockopt(tcpSocket->socketDescriptor(), IPPROTO_TCP, TCP_NOPUSH, &value, sizeof(value));
+#else
+    Q_UNUSED(value);
+#endif
+}
+
+void Connection::writeResponses()
+{
+    while (sockets.count()) {
+        Socket *httpSocket = sockets.first();
+
+        // Send anything the socket wrote while it was waiting for its turn
+        httpSocket->d->flushWriteBuffer();
+
+        // Stop at the first response that is still being written
+        if (httpSocket->d->writeState != SocketPrivate::WriteFinished) {
+            break;
+        }
+
+        sockets.removeFirst();
+        disconnect(httpSocket, &QObject::destroyed, this, &Connection::onSocketDestroyed);
+
+        // Hand everything to the kernel before removing the cork so that
+        // the end of the response is sent right away
+        if (corked) {
+            tcpSocket->flush();
+            setCorked(false);
+        }
+
+        if (!httpSocket->d->keepAlive) {
+
+            // Delete the socket once the client disconnects
+            if (isDisconnected()) {
+                httpSocket->deleteLater();
+            } else {
+                connect(this, &Connection::disconnected, httpSocket, &Socket::deleteLater);
+            }
+
+            // Any requests read after this one are discarded
+            close();
+            return;
+        }
+
+        // The socket is no longer needed once its response is written
+        httpSocket->deleteLater();
+    }
+
+    // No further requests are read from a connection that is draining
+    if (draining && sockets.isEmpty()) {
+        close();
+        return;
+    }
+
+    // Data for another request may have arrived while the queue was full -
+    // if so, begin processing it, otherwise wait for it
+    if (sockets.count() || readBuffer.count() || socket->bytesAvailable()) {
+        QTimer::singleShot(0, this, &Connection::onReadyRead);
+    } else {
+        readTimer.start(timerWheel, idleTimeout);
+    }
+}
+
+void Connection::onReadTimeout()
+{
+    // A connection waiting for the next request can be closed normally
+    if (sockets.isEmpty()) {
+        close();
+    } else {
+        abort();
+    }
+}
+
+void Connection::onWriteTimeout()
+{
+    abort();
+}
+
+void Connection::onReadyRead()
+{
+    while (true) {
+
+        // If the last request was read in full, incoming data marks the start
+        // of a new one and a socket must be created for it - nothing is read
+        // from the device while this is not possible
+        Socket *httpSocket = reader();
+        if (!httpSocket) {
+            if (!isAccepting()) {
+                return;
+            }
+
+            readSocket();
+            if (readBuffer.isEmpty()) {
+                return;
+            }
+
+            // The headers must arrive in full within the time limit
+            readTimer.start(timerWheel, headerTimeout);
+
+            httpSocket = new Socket(this, this);
+            sockets.append(httpSocket);
+            ++requestCount;
+            ++liveSockets;
+
+            // The connection cannot be reused until every socket is gone
+            connect(httpSocket, &QObject::destroyed, this, &Connection::onSocketReleased);
+
+            // If the socket is destroyed before its response is complete,
+            // there is no way to continue using the connection
+            connect(httpSocket, &QObject::destroyed, this, &Connection::onSocketDestroyed);
+
+            Q_EMIT newSocket(httpSocket);
+        } else if (socket->isOpen()) {
+            readSocket();
+        }
+
+        httpSocket->d->read(readBuffer);
+
+        // Wait for more data if the request is still incomplete - while
+        // reading the body, each time data arrives restarts the timeout
+        if (httpSocket->d->readState == SocketPrivate::ReadData) {
+            readTimer.start(timerWheel, bodyTimeout);
+            return;
+        }
+        if (httpSocket->d->readState != SocketPrivate::ReadFinished) {
+            return;
+        }
+
+        // No timeout applies while waiting for the response
+        readTimer.stop();
+    }
+}
+
+void Connection::onBytesWritten(qint64 bytes)
+{
+    if (counters) {
+        counters->bytesWritten.fetchAndAddRelaxed(bytes);
+    }
+
+    // Attribute the bytes to the sockets that wrote them in the order that
+    // they were written
+    while (bytes > 0 && pendingWrites.count()) {
+        QPointer<Socket> httpSocket = pendingWrites.first().first;
+        qint64 count = qMin(bytes, pendingWrites.first().second);
+
+        bytes -= count;
+        pendingWrites.first().second -= count;
+        if (!pendingWrites.first().second) {
+            pendingWrites.removeFirst();
+        }
+
+        if (httpSocket) {
+            httpSocket->d->onBytesWritten(count);
+        }
+    }
+
+    // Progress was made, so the client is still receiving the response
+    if (socket->bytesToWrite()) {
+        writeTimer.start(timerWheel, writeTimeout);
+    } else {
+        writeTimer.stop();
+    }
+}
+
+void Connection::onDisconnected()
+{
+    closing = true;
+    readTimer.stop();
+    writeTimer.stop();
+
+    // Every request still waiting for its response is affected
+    QList<QPointer<Socket> > waiting;
+    foreach (Socket *httpSocket, sockets) {
+        waiting.append(httpSocket);
+    }
+    foreach (QPointer<Socket> httpSocket, waiting) {
+        if (httpSocket) {
+            Q_EMIT httpSocket->disconnected();
+        }
+    }
+
+    Q_EMIT disconnected();
+
+    if (!liveSockets) {
+        Q_EMIT released();
+    }
+}
+
+void Connection::onSocketDestroyed(QObject *object)
+{
+    if (sockets.removeOne(static_cast<Socket*>(object))) {
+        close();
+    }
+}
+
+void Connection::onSocketReleased()
+{
+    if (!--liveSockets && isDisconnected()) {
+        Q_EMIT released();
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_CONNECTION_H
+#define QHTTPENGINE_CONNECTION_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QSharedPointer>
+
+#include "errorpages.h"
+#include "timerwheel.h"
+
+class QAbstractSocket;
+class QIODevice;
+class QLocalSocket;
+
+namespace QHttpEngine
+{
+
+class Socket;
+struct Counters;
+
+// Default limits for the request headers
+const int DefaultMaxHeaderSize = 65536;
+const int DefaultMaxHeaderCount = 100;
+
+// Default amount of a request body held in memory
+const qint64 DefaultBodyBufferSize = 1048576;
+
+/**
+ * @brief Persistent HTTP connection
+ *
+ * A connection owns the device for a client - usually a QTcpSocket or a
+ * QLocalSocket, but any sequential QIODevice will do - and reads requests
+ * from it one after another. A new [Socket](@ref QHttpEngine::Socket) is created for
+ * each request. Once the response for a request is complete, the connection
+ * is either reused for the next request or closed, depending on what the
+ * client asked for and on the limits set for the connection.
+ *
+ * Requests that a client sends without waiting for the previous response
+ * (pipelining) are read ahead and each is given its own socket right away.
+ * The sockets are kept in a queue and only the socket at the front of the
+ * queue writes to the device - data written by the others is held until
+ * the responses before it are complete.
+ *
+ * Timeouts are scheduled on a TimerWheel shared with other connections. The
+ * connection is closed if it remains idle between requests, takes too long
+ * to send the headers of a request, stops sending the body of a request or
+ * stops receiving a response.
+ *
+ * Once the client disconnects and all of the sockets for its requests are
+ * destroyed, the connection (along with its device) may be reset and reused
+ * for another client.
+ *
+ * For a device other than a socket, the client is considered disconnected
+ * once the device is closed.
+ *
+ * A connection that is draining reads no further requests. It is closed as
+ * soon as the responses to the requests already received are written.
+ */
+class Connection : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    Connection(QIODevice *socket, QObject *parent = 0);
+
+    void setMaxRequests(int maxRequests);
+    void setMaxPipelinedRequests(int maxPipelinedRequests);
+    void setTimerWheel(TimerWheel *timerWheel);
+    void setIdleTimeout(int idleTimeout);
+    void setHeaderTimeout(int headerTimeout);
+    void setBodyTimeout(int bodyTimeout);
+    void setWriteTimeout(int writeTimeout);
+    void setMaxHeaderSize(int maxHeaderSize);
+    void setMaxHeaderCount(int maxHeaderCount);
+    void setMaxBodySize(qint64 maxBodySize);
+    void setBodyBufferSize(qint64 bodyBufferSize);
+    void setCorkEnabled(bool corkEnabled);
+    void setErrorPages(const QSharedPointer<const ErrorPages> &errorPages);
+    void setCounters(Counters *counters);
+
+    int maxHeaderSize() const;
+    int maxHeaderCount() const;
+    qint64 maxBodySize() const;
+    qint64 bodyBufferSize() const;
+    const ErrorPages *errorPages() const;
+
+    void start(Socket *socket = 0);
+    void reset();
+    void drain();
+
+    int socketCount() const;
+
+    bool isKeepAliveAllowed() const;
+    bool isIdle() const;
+    bool isConnected() const;
+    bool isDisconnected() const;
+
+    qint64 write(Socket *httpSocket, const char *data, qint64 len);
+    void finish(Socket *httpSocket);
+    void close();
+    void abort();
+
+    QIODevice *const socket;
+
+    // The device as a TCP or local socket (if it is one)
+    QAbstractSocket *const tcpSocket;
+    QLocalSocket *const localSocket;
+
+Q_SIGNALS:
+
+    void newSocket(Socket *httpSocket);
+    void disconnected();
+    void released();
+
+private Q_SLOTS:
+
+    void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void onDisconnected();
+    void onSocketDestroyed(QObject *object);
+    void onSocketReleased();
+
+private:
+
+    bool isAccepting() const;
+    Socket *reader() const;
+    void readSocket();
+    void setCorked(bool corked);
+    void writeResponses();
+
+    void onReadTimeout();
+    void onWriteTimeout();
+
+    QByteArray readBuffer;
+
+    // Sockets waiting for their response to complete in the order that the
+    // requests were received
+    QList<Socket*> sockets;
+
+    int requestCount;
+    int liveSockets;
+    int maxRequests;
+    int maxPipelinedRequests;
+    int headerSizeLimit;
+    int headerCountLimit;
+    qint64 bodySizeLimit;
+    qint64 bodyBufferLimit;
+    bool corkEnabled;
+    bool corked;
+    bool closing;
+    bool draining;
+
+    // Error responses rendered from a custom template (if any)
+    QSharedPointer<const ErrorPages> customErrorPages;
+
+    // Counters of the process that the bytes written are added to (if any)
+    Counters *counters;
+
+    TimerWheel *timerWheel;
+    int idleTimeout;
+    int headerTimeout;
+    int bodyTimeout;
+    int writeTimeout;
+
+    // Only one read timeout applies at a time - waiting for a request,
+    // reading its headers or reading its body - but a response may be
+    // written at the same time
+    WheelTimer readTimer;
+    WheelTimer writeTimer;
+
+    // Bytes handed to the device that have not been written yet, along
+    // with the socket that wrote them
+    QList<QPair<QPointer<Socket>, qint64> > pendingWrites;
+};
+
+}
+
+#endif // QHTTPENGINE_CONNECTION_H
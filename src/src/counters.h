@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_COUNTERS_H
+#define QHTTPENGINE_COUNTERS_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+namespace QHttpEngine
+{
+
+/**
+ * @brief Counters for the connections served by a process
+ *
+ * The workers of the process update the counters atomically as they go.
+ * When a server runs several processes, the counters for all of them are
+ * kept in memory shared between the processes, so that any one of them can
+ * report on the whole server.
+ */
+struct Counters
+{
+    QAtomicInteger<qint64> pid;
+    QAtomicInteger<qint64> requestCount;
+    QAtomicInteger<qint64> bytesWritten;
+    QAtomicInt connectionCount;
+};
+
+}
+
+#endif // QHTTPENGINE_COUNTERS_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "errorpages.h"
+#include "socket_p.h"
+
+using namespace QHttpEngine;
+
+// Predefined error response requires a simple HTML template to be returned to
+// the client describing the error condition
+const char *const DefaultErrorTemplate =
+        "<!DOCTYPE html>"
+        "<html>"
+          "<head>"
+            "<meta charset=\"utf-8\">"
+            "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">"
+            "<title>%1 %2</title>"
+          "</head>"
+          "<body>"
+            "<h1>%1 %2</h1>"
+            "<p>"
+              "An error has occurred while trying to display the requested resource. "
+              "Please contact the website owner if this error persists."
+            "</p>"
+            "<hr>"
+            "<p><em>QHttpEngine %3</em></p>"
+          "</body>"
+        "</html>";
+
+ErrorPages::ErrorPages(const QString &errorTemplate)
+    : errorTemplate(errorTemplate.isEmpty() ? QString(DefaultErrorTemplate) : errorTemplate)
+{
+    // Only render pages for the status codes that indicate an error
+#define QHTTPENGINE_ADD_PAGE(name, code, reason) \
+    if (code >= 400) { \
+        addPage(code); \
+    }
+    QHTTPENGINE_STATUS_CODES(QHTTPENGINE_ADD_PAGE)
+#undef QHTTPENGINE_ADD_PAGE
+}
+
+const ErrorPages::Page *ErrorPages::page(int statusCode) const
+{
+    auto i = pages.constFind(statusCode);
+    return i == pages.constEnd() ? 0 : &i.value();
+}
+
+QByteArray ErrorPages::render(int statusCode, const QByteArray &statusReason) const
+{
+    return errorTemplate
+            .arg(statusCode)
+            .arg(statusReason.constData())
+            .arg(QHTTPENGINE_VERSION)
+            .toUtf8();
+}
+
+const ErrorPages *ErrorPages::defaultPages()
+{
+    static const ErrorPages pages;
+    return &pages;
+}
+
+void ErrorPages::addPage(int statusCode)
+{
+    QByteArray body = render(statusCode, SocketPrivate::statusReason(statusCode));
+
+    // The headers are in the same order that Socket::writeHeaders() would
+    // write them in
+    const char *const connection[3] = {
+        "",
+        "Connection: close\r\n",
+        "Connection: keep-alive\r\n"
+    };
+
+    Page page;
+    for (int i = 0; i < 3; ++i) {
+        QByteArray response = SocketPrivate::statusLine(statusCode);
+        response.append(connection[i]);
+        response.append("Content-Length: ");
+        response.append(QByteArray::number(body.length()));
+        response.append("\r\nContent-Type: text/html\r\n\r\n");
+        page.headerSizes[i] = response.size();
+        response.append(body);
+        page.responses[i] = response;
+    }
+    pages.insert(statusCode, page);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_ERRORPAGES_H
+#define QHTTPENGINE_ERRORPAGES_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+namespace QHttpEngine
+{
+
+/**
+ * @brief Error responses rendered in advance
+ *
+ * The template is rendered once for each of the error status codes that
+ * have a predefined reason. Each page holds the complete response - status
+ * line, headers and body - in every form that the Connection header can
+ * take, so that writing an error does not require building anything.
+ *
+ * Pages are never modified once created, so a set can be shared by any
+ * number of connections and threads.
+ */
+class ErrorPages
+{
+public:
+
+    /**
+     * @brief Forms of the Connection header in a rendered response
+     */
+    enum Variant {
+        /// No Connection header
+        Plain,
+        /// "Connection: close" for HTTP/1.1 clients
+        Close,
+        /// "Connection: keep-alive" for HTTP/1.0 clients
+        KeepAlive
+    };
+
+    /**
+     * @brief Complete response for a single status code
+     */
+    struct Page {
+        QByteArray responses[3];
+        int headerSizes[3];
+    };
+
+    explicit ErrorPages(const QString &errorTemplate = QString());
+
+    const Page *page(int statusCode) const;
+    QByteArray render(int statusCode, const QByteArray &statusReason) const;
+
+    static const ErrorPages *defaultPages();
+
+private:
+
+    void addPage(int statusCode);
+
+    QString errorTemplate;
+    QHash<int, Page> pages;
+};
+
+}
+
+#endif // QHTTPENGINE_ERRORPAGES_H
@@ -58,13 +58,17 @@ FilesystemHandlerPrivate::FilesystemHandlerPrivate(FilesystemHandler *handler)
 
 bool FilesystemHandlerPrivate::absolutePath(const QString &path, QString &absolutePath)
 {
+    // QDir caches the absolute path the first time it is needed, so a copy
+    // is used in case requests are processed on several threads at once
+    QDir root(documentRoot.path());
+
     // Resolve the path according to the document root
-    absolutePath = documentRoot.absoluteFilePath(path);
+    absolutePath = root.absoluteFilePath(path);
 
     // Perhaps not the most efficient way of doing things, but one way to
     // determine if path is within the document root is to convert it to a
     // relative path and check to see if it begins with "../" (it shouldn't)
-    return documentRoot.exists(absolutePath) && !documentRoot.relativeFilePath(path).startsWith("../");
+    return root.exists(absolutePath) && !root.relativeFilePath(path).startsWith("../");
 }
 
 QByteArray FilesystemHandlerPrivate::mimeType(const QString &absolutePath)
@@ -75,30 +79,33 @@ QByteArray FilesystemHandlerPrivate::mimeType(const QString &absolutePath)
 
 void FilesystemHandlerPrivate::processFile(Socket *socket, const QString &absolutePath)
 {
-    // Attempt to open the file for reading
-    QFile *file = new QFile(absolutePath);
-    if (!file->open(QIODevice::ReadOnly)) {
-        delete file;
-
-        socket->writeError(Socket::Forbidden);
-        return;
-    }
-
-    // Create a QIODeviceCopier to copy the file contents to the socket
-    QIODeviceCopier *copier = new QIODeviceCopier(file, socket);
-    connect(copier, &QIODeviceCopier::finished, copier, &QIODeviceCopier::deleteLater);
-    connect(copier, &QIODeviceCopier::finished, file, &QFile::deleteLater);
-    connect(copier, &QIODeviceCopier::finished, [socket]() {
-        socket->close();
-    });
+    QFile *file = 0;
+    qint64 fileSize;
+
+    // The body of the response to a HEAD request is never sent, so the file
+    // does not need to be opened
+    if (socket->method() == Socket::HEAD) {
+        QFileInfo info(absolutePath);
+        if (!info.isReadable()) {
+            socket->writeError(Socket::Forbidden);
+            return;
+        }
+        fileSize = info.size();
+    } else {
 
-    // Stop the copier if the socket is disconnected
-    connect(socket, &Socket::disconnected, copier, &QIODeviceCopier::stop);
+        // Attempt to open the file for reading
+        file = new QFile(absolutePath);
+        if (!file->open(QIODevice::ReadOnly)) {
+            delete file;
 
-    qint64 fileSize = file->size();
+            socket->writeError(Socket::Forbidden);
+            return;
+        }
+        fileSize = file->size();
+    }
 
     // Checking for partial content request
-    QByteArray rangeHeader = socket->headers().value("Range");
+    QByteArray rangeHeader = socket->header(HeaderList::Range);
     Range range;
 
     if (!rangeHeader.isEmpty() && rangeHeader.startsWith("bytes=")) {
@@ -115,7 +122,6 @@ void FilesystemHandlerPrivate::processFile(Socket *socket, const QString &absolu
         socket->setStatusCode(Socket::PartialContent);
         socket->setHeader("Content-Length", QByteArray::number(range.length()));
         socket->setHeader("Content-Range", QByteArray("bytes ") + range.contentRange().toLatin1());
-        copier->setRange(range.from(), range.to());
     } else {
         // If range is invalid or if it is not a partial content request,
         // send full file
@@ -126,6 +132,26 @@ void FilesystemHandlerPrivate::processFile(Socket *socket, const QString &absolu
     socket->setHeader("Content-Type", mimeType(absolutePath));
     socket->writeHeaders();
 
+    if (!file) {
+        socket->close();
+        return;
+    }
+
+    // Create a QIODeviceCopier to copy the file contents to the socket
+    QIODeviceCopier *copier = new QIODeviceCopier(file, socket);
+    connect(copier, &QIODeviceCopier::finished, copier, &QIODeviceCopier::deleteLater);
+    connect(copier, &QIODeviceCopier::finished, file, &QFile::deleteLater);
+    connect(copier, &QIODeviceCopier::finished, [socket]() {
+        socket->close();
+    });
+
+    // Stop the copier if the socket is disconnected
+    connect(socket, &Socket::disconnected, copier, &QIODeviceCopier::stop);
+
+    if (range.isValid()) {
+        copier->setRange(range.from(), range.to());
+    }
+
     // Start the copy
     copier->start();
 }
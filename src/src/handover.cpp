@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <QFile>
+
+#if defined(Q_OS_UNIX)
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+#include "handover.h"
+
+using namespace QHttpEngine;
+
+#if defined(Q_OS_UNIX)
+
+// Fill in the address of a Unix domain socket, failing if the path is too
+// long to fit
+static bool unixAddress(const QString &path, sockaddr_un *address)
+{
+    QByteArray encodedPath = QFile::encodeName(path);
+    if (encodedPath.isEmpty() || encodedPath.size() >= static_cast<int>(sizeof(address->sun_path))) {
+        return false;
+    }
+
+    std::memset(address, 0, sizeof(sockaddr_un));
+    address->sun_family = AF_UNIX;
+    std::memcpy(address->sun_path, encodedPath.constData(), encodedPath.size());
+    return true;
+}
+
+// Wait for the descriptor to become readable
+static bool waitForRead(int fd, int msec)
+{
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret;
+    while ((ret = poll(&pfd, 1, msec)) == -1 && errno == EINTR) {}
+    return ret > 0;
+}
+
+// Determine whether the process at the other end of the channel runs as the
+// same user - descriptors are only exchanged with such a process
+static bool isSameUser(int fd)
+{
+#if defined(SO_PEERCRED) && defined(Q_OS_LINUX)
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 &&
+            credentials.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::geteuid();
+#endif
+}
+
+// Close each descriptor passed with a message
+static void closeDescriptors(msghdr *message)
+{
+    for (cmsghdr *header = CMSG_FIRSTHDR(message); header; header = CMSG_NXTHDR(message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (int i = 0; i < count; ++i) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            ::close(fd);
+        }
+    }
+}
+
+#endif
+
+Handover::Handover(int channel)
+    : channel(channel)
+{
+}
+
+Handover::~Handover()
+{
+#if defined(Q_OS_UNIX)
+    ::close(channel);
+#endif
+}
+
+QSharedPointer<Handover> Handover::connectTo(const QString &path)
+{
+#if defined(Q_OS_UNIX)
+    sockaddr_un address;
+    if (!unixAddress(path, &address)) {
+        return QSharedPointer<Handover>();
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return QSharedPointer<Handover>();
+    }
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+            !isSameUser(fd)) {
+        ::close(fd);
+        return QSharedPointer<Handover>();
+    }
+
+    return QSharedPointer<Handover>(new Handover(fd));
+#else
+    Q_UNUSED(path);
+    return QSharedPointer<Handover>();
+#endif
+}
+
+QSharedPointer<Handover> Handover::waitFor(const QString &path, int msec)
+{
+#if defined(Q_OS_UNIX)
+    sockaddr_un address;
+    if (!unixAddress(path, &address)) {
+        return QSharedPointer<Handover>();
+    }
+
+    // A socket left behind by an earlier attempt would prevent binding -
+    // anything else at the path is left alone
+    struct stat info;
+    if (::lstat(address.sun_path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            return QSharedPointer<Handover>();
+        }
+        ::unlink(address.sun_path);
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return QSharedPointer<Handover>();
+    }
+
+    int channel = -1;
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+        if (::listen(fd, 1) == 0 && waitForRead(fd, msec)) {
+            while ((channel = ::accept(fd, 0, 0)) == -1 && errno == EINTR) {}
+        }
+        ::unlink(address.sun_path);
+    }
+    ::close(fd);
+
+    // Any local process may connect, but only one running as the same user
+    // is trusted to provide the listening socket
+    if (channel != -1 && !isSameUser(channel)) {
+        ::close(channel);
+        channel = -1;
+    }
+
+    return channel == -1 ? QSharedPointer<Handover>() : QSharedPointer<Handover>(new Handover(channel));
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(msec);
+    return QSharedPointer<Handover>();
+#endif
+}
+
+bool Handover::send(Type type, qintptr descriptor)
+{
+#if defined(Q_OS_UNIX)
+    char data = static_cast<char>(type);
+    iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    std::memset(&control, 0, sizeof(control));
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    int fd = static_cast<int>(descriptor);
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    QMutexLocker locker(&mutex);
+
+    ssize_t ret;
+    while ((ret = ::sendmsg(channel, &message, 0)) == -1 && errno == EINTR) {}
+    return ret == 1;
+#else
+    Q_UNUSED(type);
+    Q_UNUSED(descriptor);
+    return false;
+#endif
+}
+
+qintptr Handover::receive(Type *type, int msec)
+{
+#if defined(Q_OS_UNIX)
+    if (!waitForRead(channel, msec)) {
+        return -1;
+    }
+
+    char data;
+    iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    // The descriptor must not leak into processes started later on
+#if defined(MSG_CMSG_CLOEXEC)
+    const int flags = MSG_CMSG_CLOEXEC;
+#else
+    const int flags = 0;
+#endif
+
+    // Nothing is left once the other process closes the channel
+    ssize_t ret;
+    while ((ret = ::recvmsg(channel, &message, flags)) == -1 && errno == EINTR) {}
+    if (ret != 1) {
+        if (ret > 0) {
+            closeDescriptors(&message);
+        }
+        return -1;
+    }
+
+    // A message with more than one descriptor was cut short - whatever did
+    // arrive with it cannot be trusted
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if ((message.msg_flags & MSG_CTRUNC) || !header || header->cmsg_level != SOL_SOCKET ||
+            header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(int))) {
+        closeDescriptors(&message);
+        return -1;
+    }
+
+    int fd;
+    std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+#if !defined(MSG_CMSG_CLOEXEC)
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+    *type = static_cast<Type>(data);
+    return fd;
+#else
+    Q_UNUSED(type);
+    Q_UNUSED(msec);
+    return -1;
+#endif
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_HANDOVER_H
+#define QHTTPENGINE_HANDOVER_H
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+
+namespace QHttpEngine
+{
+
+/**
+ * @brief Channel for passing sockets to another process
+ *
+ * A server that is being replaced connects to the Unix domain socket that
+ * the new process waits on and sends its listening socket - and optionally
+ * its idle connections - through it with SCM_RIGHTS. Each message carries a
+ * single byte for the type of the socket along with its descriptor. The
+ * channel is closed once the last reference to it is released, which tells
+ * the new process that nothing else will follow. Descriptors are only
+ * exchanged with a process running as the same user.
+ *
+ * Workers on other threads send their idle connections through the same
+ * channel, so sending is serialized.
+ */
+class Handover
+{
+public:
+
+    enum Type {
+        ListeningSocket = 'L',
+        ClientSocket = 'C'
+    };
+
+    explicit Handover(int channel);
+    ~Handover();
+
+    static QSharedPointer<Handover> connectTo(const QString &path);
+    static QSharedPointer<Handover> waitFor(const QString &path, int msec);
+
+    bool send(Type type, qintptr descriptor);
+    qintptr receive(Type *type, int msec);
+
+private:
+
+    const int channel;
+    QMutex mutex;
+};
+
+}
+
+#endif // QHTTPENGINE_HANDOVER_H
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QtGlobal>
+
+#include <qhttpengine/headerlist.h>
+
+#include "headerlist_p.h"
+
+using namespace QHttpEngine;
+
+// Names of the well-known headers (and their lengths) in the same order as
+// HeaderList::Id
+const struct {
+    const char *name;
+    int length;
+} WellKnownNames[HeaderList::IdCount] = {
+    {"Accept", 6},
+    {"Accept-Encoding", 15},
+    {"Accept-Language", 15},
+    {"Authorization", 13},
+    {"Cache-Control", 13},
+    {"Connection", 10},
+    {"Content-Length", 14},
+    {"Content-Type", 12},
+    {"Cookie", 6},
+    {"Expect", 6},
+    {"Host", 4},
+    {"If-Modified-Since", 17},
+    {"If-None-Match", 13},
+    {"If-Range", 8},
+    {"Keep-Alive", 10},
+    {"Origin", 6},
+    {"Range", 5},
+    {"Referer", 7},
+    {"Transfer-Encoding", 17},
+    {"Upgrade", 7},
+    {"User-Agent", 10},
+    {"X-Forwarded-For", 15},
+    {"X-Real-IP", 9}
+};
+
+HeaderListPrivate::HeaderListPrivate()
+{
+    for (int i = 0; i < HeaderList::IdCount; ++i) {
+        index[i] = -1;
+    }
+}
+
+int HeaderListPrivate::find(const char *name, int length) const
+{
+    // Search backwards so that the last value is found first
+    for (int i = entries.count() - 1; i >= 0; --i) {
+        const Entry &entry = entries.at(i);
+        if (entry.nameLength == length &&
+                qstrnicmp(data.constData() + entry.nameOffset, name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+HeaderList::HeaderList()
+    : d(new HeaderListPrivate)
+{
+}
+
+HeaderList::HeaderList(const HeaderList &other)
+    : d(new HeaderListPrivate)
+{
+    *this = other;
+}
+
+HeaderList::~HeaderList()
+{
+    delete d;
+}
+
+HeaderList &HeaderList::operator=(const HeaderList &other)
+{
+    if (&other != this) {
+        d->data = other.d->data;
+        d->entries = other.d->entries;
+        for (int i = 0; i < IdCount; ++i) {
+            d->index[i] = other.d->index[i];
+        }
+    }
+
+    return *this;
+}
+
+HeaderList::Id HeaderList::id(const char *name, int length)
+{
+    if (length <= 0) {
+        return Unknown;
+    }
+
+    // The length and the first letter (and the eighth letter for the two
+    // Accept-* headers of the same length) leave a single candidate, which
+    // is then compared in full
+    char first = name[0] | 0x20;
+    Id candidate = Unknown;
+    switch (length) {
+    case 4:
+        candidate = Host;
+        break;
+    case 5:
+        candidate = Range;
+        break;
+    case 6:
+        switch (first) {
+        case 'a': candidate = Accept; break;
+        case 'c': candidate = Cookie; break;
+        case 'e': candidate = Expect; break;
+        case 'o': candidate = Origin; break;
+        }
+        break;
+    case 7:
+        switch (first) {
+        case 'r': candidate = Referer; break;
+        case 'u': candidate = Upgrade; break;
+        }
+        break;
+    case 8:
+        candidate = IfRange;
+        break;
+    case 9:
+        candidate = XRealIP;
+        break;
+    case 10:
+        switch (first) {
+        case 'c': candidate = Connection; break;
+        case 'k': candidate = KeepAlive; break;
+        case 'u': candidate = UserAgent; break;
+        }
+        break;
+    case 12:
+        candidate = ContentType;
+        break;
+    case 13:
+        switch (first) {
+        case 'a': candidate = Authorization; break;
+        case 'c': candidate = CacheControl; break;
+        case 'i': candidate = IfNoneMatch; break;
+        }
+        break;
+    case 14:
+        candidate = ContentLength;
+        break;
+    case 15:
+        switch (first) {
+        case 'a': candidate = (name[7] | 0x20) == 'e' ? AcceptEncoding : AcceptLanguage; break;
+        case 'x': candidate = XForwardedFor; break;
+        }
+        break;
+    case 17:
+        switch (first) {
+        case 'i': candidate = IfModifiedSince; break;
+        case 't': candidate = TransferEncoding; break;
+        }
+        break;
+    }
+
+    if (candidate != Unknown && qstrnicmp(WellKnownNames[candidate].name, name, length) == 0) {
+        return candidate;
+    }
+    return Unknown;
+}
+
+HeaderList::Id HeaderList::id(const QByteArray &name)
+{
+    return id(name.constData(), name.size());
+}
+
+QByteArray HeaderList::name(Id id)
+{
+    return id > Unknown && id < IdCount ? QByteArray(WellKnownNames[id].name, WellKnownNames[id].length) : QByteArray();
+}
+
+void HeaderList::insert(const char *name, int nameLength, const char *value, int valueLength)
+{
+    HeaderListPrivate::Entry entry;
+    entry.id = id(name, nameLength);
+    entry.nameOffset = d->data.size();
+    entry.nameLength = nameLength;
+    entry.valueOffset = entry.nameOffset + nameLength;
+    entry.valueLength = valueLength;
+
+    d->data.append(name, nameLength);
+    d->data.append(value, valueLength);
+
+    if (entry.id != Unknown) {
+        d->index[entry.id] = d->entries.count();
+    }
+    d->entries.append(entry);
+}
+
+void HeaderList::insert(const QByteArray &name, const QByteArray &value)
+{
+    insert(name.constData(), name.size(), value.constData(), value.size());
+}
+
+void HeaderList::clear()
+{
+    *this = HeaderList();
+}
+
+int HeaderList::count() const
+{
+    return d->entries.count();
+}
+
+QByteArray HeaderList::nameAt(int index) const
+{
+    const HeaderListPrivate::Entry &entry = d->entries.at(index);
+    return d->data.mid(entry.nameOffset, entry.nameLength);
+}
+
+QByteArray HeaderList::valueAt(int index) const
+{
+    const HeaderListPrivate::Entry &entry = d->entries.at(index);
+
+    // Present but empty headers must not be mistaken for missing ones
+    if (!entry.valueLength) {
+        return QByteArray("");
+    }
+    return d->data.mid(entry.valueOffset, entry.valueLength);
+}
+
+HeaderList::Id HeaderList::idAt(int index) const
+{
+    return d->entries.at(index).id;
+}
+
+bool HeaderList::contains(Id id) const
+{
+    return id > Unknown && id < IdCount && d->index[id] != -1;
+}
+
+bool HeaderList::contains(const QByteArray &name) const
+{
+    return d->find(name.constData(), name.size()) != -1;
+}
+
+QByteArray HeaderList::value(Id id) const
+{
+    return contains(id) ? valueAt(d->index[id]) : QByteArray();
+}
+
+QByteArray HeaderList::value(const QByteArray &name) const
+{
+    Id headerId = id(name);
+    if (headerId != Unknown) {
+        return value(headerId);
+    }
+
+    int index = d->find(name.constData(), name.size());
+    return index == -1 ? QByteArray() : valueAt(index);
+}
+
+QMultiMap<IByteArray, QByteArray> HeaderList::toMap() const
+{
+    QMultiMap<IByteArray, QByteArray> map;
+    for (int i = 0; i < d->entries.count(); ++i) {
+        map.insert(nameAt(i), valueAt(i));
+    }
+    return map;
+}
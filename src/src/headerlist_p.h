@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_HEADERLIST_P_H
+#define QHTTPENGINE_HEADERLIST_P_H
+
+#include <QVector>
+
+#include <qhttpengine/headerlist.h>
+
+namespace QHttpEngine
+{
+
+class HeaderListPrivate
+{
+public:
+
+    HeaderListPrivate();
+
+    int find(const char *name, int length) const;
+
+    // Position of a header's name and value within the buffer
+    struct Entry {
+        HeaderList::Id id;
+        int nameOffset;
+        int nameLength;
+        int valueOffset;
+        int valueLength;
+    };
+
+    QByteArray data;
+    QVector<Entry> entries;
+
+    // Index of the last entry for each well-known header (or -1)
+    int index[HeaderList::IdCount];
+};
+
+}
+
+#endif // QHTTPENGINE_HEADERLIST_P_H
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include <qhttpengine/ibytearray.h>
+
+using namespace QHttpEngine;
+
+namespace
+{
+
+/*
+ * ASCII letters are folded to lowercase a word at a time: each byte below
+ * 0x80 has 0x20 added if it lies within 'A'..'Z'. Bytes with the high bit
+ * set are left untouched, matching QByteArray::toLower().
+ */
+const quint64 Ones = Q_UINT64_C(0x0101010101010101);
+const quint64 HighBits = Ones * 0x80;
+const quint64 LowBits = Ones * 0x7f;
+
+inline quint64 load(const char *data)
+{
+    quint64 word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline quint64 foldWord(quint64 word)
+{
+    quint64 heptets = word & LowBits;
+    quint64 geA = heptets + Ones * (0x80 - 'A');
+    quint64 gtZ = heptets + Ones * (0x80 - 'Z' - 1);
+    quint64 upper = (geA ^ gtZ) & ~word & HighBits;
+    return word | (upper >> 2);
+}
+
+inline uchar foldChar(uchar c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+int compareBytes(const char *data1, const char *data2, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        int diff = foldChar(data1[i]) - foldChar(data2[i]);
+        if (diff) {
+            return diff;
+        }
+    }
+    return 0;
+}
+
+bool equalBytes(const char *data1, const char *data2, int size)
+{
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        if (foldWord(load(data1 + i)) != foldWord(load(data2 + i))) {
+            return false;
+        }
+    }
+    return compareBytes(data1 + i, data2 + i, size - i) == 0;
+}
+
+}
+
+int IByteArray::caseInsensitiveCompare(const char *data1, int size1, const char *data2, int size2)
+{
+    int size = qMin(size1, size2);
+    int i = 0;
+
+    // Skip over matching words and locate the first difference bytewise
+    for (; i + 8 <= size; i += 8) {
+        if (foldWord(load(data1 + i)) != foldWord(load(data2 + i))) {
+            break;
+        }
+    }
+    int diff = compareBytes(data1 + i, data2 + i, size - i);
+    if (diff) {
+        return diff;
+    }
+    return size1 - size2;
+}
+
+int IByteArray::caseInsensitiveCompare(const QByteArray &a1, const QString &a2)
+{
+    const QChar *data2 = a2.constData();
+    int size = qMin(a1.size(), a2.size());
+
+    for (int i = 0; i < size; ++i) {
+        uchar c1 = a1.at(i);
+        ushort c2 = data2[i].unicode();
+
+        // The rest of the data no longer lines up character by character
+        if (c1 >= 0x80 || c2 >= 0x80) {
+            return QString::fromUtf8(a1.constData() + i, a1.size() - i).toLower().compare(
+                        a2.mid(i).toLower());
+        }
+
+        int diff = foldChar(c1) - foldChar(static_cast<uchar>(c2));
+        if (diff) {
+            return diff;
+        }
+    }
+
+    // Whichever has characters left over is greater
+    return a1.size() - a2.size();
+}
+
+int IByteArray::caseInsensitiveIndexOf(const char *data, int size, const char *search, int searchSize)
+{
+    if (!searchSize) {
+        return 0;
+    }
+    uchar first = foldChar(search[0]);
+    for (int i = 0; i + searchSize <= size; ++i) {
+        if (foldChar(data[i]) == first &&
+                equalBytes(data + i + 1, search + 1, searchSize - 1)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint QHttpEngine::qHash(const IByteArray &key, uint seed)
+{
+    uint hash = seed;
+    const char *data = key.constData();
+    for (int i = 0; i < key.size(); ++i) {
+        hash = 31 * hash + foldChar(data[i]);
+    }
+    return hash;
+}
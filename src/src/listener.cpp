@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "listener.h"
+#include "server_p.h"
+#include "worker.h"
+
+using namespace QHttpEngine;
+
+Listener::Listener(ServerPrivate *server, Worker *worker)
+    : QTcpServer(worker),
+      server(server),
+      worker(worker),
+      paused(false)
+{
+    connect(worker, &Worker::connectionClosed, this, &Listener::admitWaiting);
+}
+
+Listener::~Listener()
+{
+    foreach (qintptr socketDescriptor, waiting) {
+        ServerPrivate::close(socketDescriptor);
+    }
+}
+
+void Listener::admitWaiting()
+{
+    while (waiting.count() && !isFull()) {
+        worker->connectionCount.ref();
+        worker->accept(waiting.takeFirst());
+    }
+
+    if (paused && !isFull()) {
+        paused = false;
+        if (isListening()) {
+            resumeAccepting();
+        }
+    }
+}
+
+void Listener::incomingConnection(qintptr socketDescriptor)
+{
+    // This mirrors Server::incomingConnection() for the share of the
+    // connections that this listener is responsible for
+    if (isFull() || waiting.count()) {
+        if (server->overloadPolicy == Server::PauseAccepting) {
+            waiting.append(socketDescriptor);
+            pause();
+        } else {
+            worker->reject(socketDescriptor);
+        }
+        return;
+    }
+
+    worker->connectionCount.ref();
+    worker->accept(socketDescriptor);
+
+    if (server->overloadPolicy == Server::PauseAccepting && isFull()) {
+        pause();
+    }
+}
+
+bool Listener::isFull() const
+{
+    if (server->maxConnections <= 0) {
+        return false;
+    }
+
+    int count = server->workers.count();
+    int share = (server->maxConnections + count - 1) / count;
+    return worker->connectionCount.load() >= share;
+}
+
+void Listener::pause()
+{
+    if (!paused) {
+        paused = true;
+        pauseAccepting();
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_LISTENER_H
+#define QHTTPENGINE_LISTENER_H
+
+#include <QList>
+#include <QTcpServer>
+
+namespace QHttpEngine
+{
+
+class ServerPrivate;
+class Worker;
+
+/**
+ * @brief Listening socket owned by a worker
+ *
+ * When a server listens with one socket per worker, each worker accepts
+ * connections from its own listener on its own thread, so connections are
+ * never handed from one thread to another. The kernel spreads incoming
+ * connections across the sockets.
+ *
+ * The limit for the number of connections is divided evenly between the
+ * listeners. Once a listener reaches its share, it either pauses accepting
+ * or rejects connections, just like the server itself would.
+ */
+class Listener : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+
+    Listener(ServerPrivate *server, Worker *worker);
+    ~Listener();
+
+    void admitWaiting();
+
+protected:
+
+    void incomingConnection(qintptr socketDescriptor);
+
+private:
+
+    bool isFull() const;
+    void pause();
+
+    ServerPrivate *const server;
+    Worker *const worker;
+
+    // Connections accepted while the listener was at its limit
+    bool paused;
+    QList<qintptr> waiting;
+};
+
+}
+
+#endif // QHTTPENGINE_LISTENER_H
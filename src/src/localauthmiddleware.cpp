@@ -82,7 +82,7 @@ void LocalAuthMiddleware::setHeaderName(const QByteArray &name)
 
 bool LocalAuthMiddleware::process(Socket *socket)
 {
-    if (socket->headers().value(d->tokenHeader) != d->token) {
+    if (socket->header(d->tokenHeader) != d->token) {
         socket->writeError(Socket::Forbidden);
         return false;
     }
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_LOCALLISTENER_H
+#define QHTTPENGINE_LOCALLISTENER_H
+
+#include <QLocalServer>
+
+namespace QHttpEngine
+{
+
+class ServerPrivate;
+
+/**
+ * @brief Local socket that a server accepts connections from
+ *
+ * Connections accepted from the local socket are handed to the server just
+ * like the ones accepted over TCP, so that the same workers, limits and
+ * settings apply to them.
+ */
+class LocalListener : public QLocalServer
+{
+    Q_OBJECT
+
+public:
+
+    explicit LocalListener(ServerPrivate *server);
+
+protected:
+
+    void incomingConnection(quintptr socketDescriptor);
+
+private:
+
+    ServerPrivate *const server;
+};
+
+}
+
+#endif // QHTTPENGINE_LOCALLISTENER_H
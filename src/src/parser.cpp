@@ -20,14 +20,104 @@
  * IN THE SOFTWARE.
  */
 
-#include <QPair>
-#include <QUrl>
-#include <QUrlQuery>
+#include <cstring>
 
 #include <qhttpengine/parser.h>
 
 using namespace QHttpEngine;
 
+// Determine the method, path and version from the parts of a request line
+static bool parseRequestLine(const QByteArrayList &parts, Socket::Method &method, QByteArray &path, QByteArray &version)
+{
+    if (parts.count() != 3) {
+        return false;
+    }
+
+    // Only HTTP/1.x versions are supported for now
+    if (parts[2] != "HTTP/1.0" && parts[2] != "HTTP/1.1") {
+        return false;
+    }
+
+    if (parts[0] == "OPTIONS") {
+        method = Socket::OPTIONS;
+    } else if (parts[0] == "GET") {
+        method = Socket::GET;
+    } else if (parts[0] == "HEAD") {
+        method = Socket::HEAD;
+    } else if (parts[0] == "POST") {
+        method = Socket::POST;
+    } else if (parts[0] == "PUT") {
+        method = Socket::PUT;
+    } else if (parts[0] == "DELETE") {
+        method = Socket::DELETE;
+    } else if (parts[0] == "TRACE") {
+        method = Socket::TRACE;
+    } else if (parts[0] == "CONNECT") {
+        method = Socket::CONNECT;
+    } else {
+        return false;
+    }
+
+    path = parts[1];
+    version = parts[2];
+
+    return true;
+}
+
+// Move the start and end of a string past any surrounding whitespace
+static void trim(const char *&begin, const char *&end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        ++begin;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        --end;
+    }
+}
+
+// Convert a hex digit to its value or -1 if the character is not one
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Decode percent-encoded UTF-8 - invalid escapes are left as they are
+static QString decode(const char *begin, const char *end)
+{
+    const char *percent = static_cast<const char*>(memchr(begin, '%', end - begin));
+    if (!percent) {
+        return QString::fromUtf8(begin, end - begin);
+    }
+
+    // Everything before the first escape is copied as-is
+    QByteArray data(end - begin, Qt::Uninitialized);
+    char *out = data.data();
+    memcpy(out, begin, percent - begin);
+    out += percent - begin;
+
+    for (const char *c = percent; c < end; ++c) {
+        int high, low;
+        if (*c == '%' && end - c > 2 &&
+                (high = hexValue(c[1])) != -1 && (low = hexValue(c[2])) != -1) {
+            *out++ = static_cast<char>(high << 4 | low);
+            c += 2;
+        } else {
+            *out++ = *c;
+        }
+    }
+
+    return QString::fromUtf8(data.constData(), out - data.constData());
+}
+
 void Parser::split(const QByteArray &data, const QByteArray &delim, int maxSplit, QByteArrayList &parts)
 {
     int index = 0;
@@ -49,18 +139,67 @@ void Parser::split(const QByteArray &data, const QByteArray &delim, int maxSplit
 
 bool Parser::parsePath(const QByteArray &rawPath, QString &path, Socket::QueryStringMap &queryString)
 {
-    QUrl url(rawPath);
-    if (!url.isValid()) {
-        return false;
+    path = decodePath(rawPath);
+    parseQueryString(rawPath, queryString);
+    return true;
+}
+
+QString Parser::decodePath(const QByteArray &rawPath)
+{
+    const char *begin = rawPath.constData();
+    const char *end = begin + rawPath.size();
+
+    // The path ends at the query string or fragment
+    const char *c = begin;
+    while (c < end && *c != '?' && *c != '#') {
+        ++c;
     }
+    end = c;
 
-    path = url.path();
-    QPair<QString, QString> pair;
-    foreach (pair, QUrlQuery(url.query()).queryItems()) {
-        queryString.insert(pair.first, pair.second);
+    // An absolute URI begins with the scheme and authority, which are not
+    // part of the path
+    if (begin < end && *begin != '/') {
+        const char *scheme = static_cast<const char*>(memchr(begin, ':', end - begin));
+        if (scheme && end - scheme > 2 && scheme[1] == '/' && scheme[2] == '/') {
+            const char *slash = static_cast<const char*>(memchr(scheme + 3, '/', end - scheme - 3));
+            begin = slash ? slash : end;
+        }
     }
 
-    return true;
+    return decode(begin, end);
+}
+
+void Parser::parseQueryString(const QByteArray &rawPath, Socket::QueryStringMap &queryString)
+{
+    int index = rawPath.indexOf('?');
+    if (index == -1) {
+        return;
+    }
+
+    const char *c = rawPath.constData() + index + 1;
+    const char *end = rawPath.constData() + rawPath.size();
+    const char *fragment = static_cast<const char*>(memchr(c, '#', end - c));
+    if (fragment) {
+        end = fragment;
+    }
+
+    // Items are separated by "&" and empty items are skipped - an item
+    // without "=" has an empty value
+    while (c < end) {
+        const char *itemEnd = static_cast<const char*>(memchr(c, '&', end - c));
+        if (!itemEnd) {
+            itemEnd = end;
+        }
+        if (itemEnd > c) {
+            const char *equals = static_cast<const char*>(memchr(c, '=', itemEnd - c));
+            if (equals) {
+                queryString.insert(decode(c, equals), decode(equals + 1, itemEnd));
+            } else {
+                queryString.insert(decode(c, itemEnd), QString(""));
+            }
+        }
+        c = itemEnd + 1;
+    }
 }
 
 bool Parser::parseHeaderList(const QList<QByteArray> &lines, Socket::HeaderMap &headers)
@@ -98,38 +237,60 @@ bool Parser::parseHeaders(const QByteArray &data, QList<QByteArray> &parts, Sock
 }
 
 bool Parser::parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, Socket::HeaderMap &headers)
+{
+    QByteArray version;
+    return parseRequestHeaders(data, method, path, version, headers);
+}
+
+bool Parser::parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, QByteArray &version, Socket::HeaderMap &headers)
 {
     QList<QByteArray> parts;
     if (!parseHeaders(data, parts, headers)) {
         return false;
     }
 
-    // Only HTTP/1.x versions are supported for now
-    if (parts[2] != "HTTP/1.0" && parts[2] != "HTTP/1.1") {
-        return false;
+    return parseRequestLine(parts, method, path, version);
+}
+
+bool Parser::parseRequestHeaders(const QByteArray &data, Socket::Method &method, QByteArray &path, QByteArray &version, HeaderList &headers)
+{
+    // Parse the request line
+    int end = data.indexOf("\r\n");
+    if (end == -1) {
+        end = data.size();
     }
 
-    if (parts[0] == "OPTIONS") {
-        method = Socket::OPTIONS;
-    } else if (parts[0] == "GET") {
-        method = Socket::GET;
-    } else if (parts[0] == "HEAD") {
-        method = Socket::HEAD;
-    } else if (parts[0] == "POST") {
-        method = Socket::POST;
-    } else if (parts[0] == "PUT") {
-        method = Socket::PUT;
-    } else if (parts[0] == "DELETE") {
-        method = Socket::DELETE;
-    } else if (parts[0] == "TRACE") {
-        method = Socket::TRACE;
-    } else if (parts[0] == "CONNECT") {
-        method = Socket::CONNECT;
-    } else {
+    QList<QByteArray> parts;
+    split(data.left(end), " ", 2, parts);
+    if (!parseRequestLine(parts, method, path, version)) {
         return false;
     }
 
-    path = parts[1];
+    // Add each of the headers that follow directly from the data
+    const char *const begin = data.constData();
+    while (end < data.size()) {
+        int start = end + 2;
+        end = data.indexOf("\r\n", start);
+        if (end == -1) {
+            end = data.size();
+        }
+
+        // Ensure that the delimiter (":") is present
+        const char *colon = static_cast<const char*>(memchr(begin + start, ':', end - start));
+        if (!colon) {
+            return false;
+        }
+
+        // Trim excess whitespace from the name and value
+        const char *nameBegin = begin + start;
+        const char *nameEnd = colon;
+        const char *valueBegin = colon + 1;
+        const char *valueEnd = begin + end;
+        trim(nameBegin, nameEnd);
+        trim(valueBegin, valueEnd);
+
+        headers.insert(nameBegin, nameEnd - nameBegin, valueBegin, valueEnd - valueBegin);
+    }
 
     return true;
 }
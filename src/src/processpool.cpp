@@ -0,0 +1,520 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#if defined(Q_OS_UNIX)
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+#include "counters.h"
+#include "processpool.h"
+
+using namespace QHttpEngine;
+
+// Minimum time that a worker process must run for before it is replaced
+// right away after crashing - a process that crashes sooner is replaced
+// after this long instead, so that it cannot keep the supervisor busy
+const int RestartInterval = 1000;
+
+// Interval at which the spawner checks for worker processes that exited
+const int ReapInterval = 50;
+
+#if defined(Q_OS_UNIX)
+
+namespace
+{
+
+// Message exchanged between the supervisor and the spawner - the reply to a
+// request for a worker process carries the supervisor's end of its channel
+struct Message
+{
+    enum Type {
+        SpawnRequest,
+        SpawnReply,
+        ProcessExited
+    };
+
+    qint32 type;
+    qint32 index;
+    qint64 pid;
+    qint32 status;
+};
+
+bool sendMessage(int socket, const Message &data, int fd = -1)
+{
+    iovec iov;
+    iov.iov_base = const_cast<Message*>(&data);
+    iov.iov_len = sizeof(Message);
+
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    std::memset(&control, 0, sizeof(control));
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+
+    if (fd != -1) {
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    }
+
+    ssize_t ret;
+    while ((ret = ::sendmsg(socket, &message, 0)) == -1 && errno == EINTR) {}
+    return ret == sizeof(Message);
+}
+
+// Receive a message along with the descriptor passed with it (if any) - this
+// fails once the other end of the channel is closed
+bool receiveMessage(int socket, Message *data, int *fd)
+{
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = sizeof(Message);
+
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t ret;
+    while ((ret = ::recvmsg(socket, &message, MSG_WAITALL)) == -1 && errno == EINTR) {}
+
+    *fd = -1;
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (ret > 0 && header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+            header->cmsg_len == CMSG_LEN(sizeof(int))) {
+        std::memcpy(fd, CMSG_DATA(header), sizeof(int));
+        fcntl(*fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    if (ret != sizeof(Message)) {
+        if (*fd != -1) {
+            ::close(*fd);
+        }
+        return false;
+    }
+    return true;
+}
+
+}
+
+#endif
+
+ProcessPool::ProcessPool(int size, QObject *parent)
+    : QObject(parent),
+      size(size),
+      counters(0),
+      supervisor(true),
+      stopping(false)
+{
+    spawner.pid = 0;
+    spawner.socket = -1;
+    spawner.notifier = 0;
+
+    channel.pid = 0;
+    channel.socket = -1;
+    channel.notifier = 0;
+}
+
+ProcessPool::~ProcessPool()
+{
+    // Worker processes finish their connections and exit once their channel
+    // is closed, whether or not the supervisor is still around - the same
+    // goes for the spawner
+    for (int i = 0; i < processes.count(); ++i) {
+        closeChannel(processes[i]);
+    }
+    closeChannel(channel);
+    closeChannel(spawner);
+
+#if defined(Q_OS_UNIX)
+    if (spawner.pid) {
+        waitpid(spawner.pid, 0, WNOHANG);
+    }
+    if (counters) {
+        munmap(counters, size * sizeof(Counters));
+    }
+#endif
+}
+
+bool ProcessPool::start()
+{
+#if defined(Q_OS_UNIX)
+    void *memory = mmap(0, size * sizeof(Counters), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    counters = static_cast<Counters*>(memory);
+    for (int i = 0; i < size; ++i) {
+        new (counters + i) Counters;
+
+        Process process;
+        process.pid = 0;
+        process.socket = -1;
+        process.notifier = 0;
+        processes.append(process);
+    }
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+        return false;
+    }
+
+    // Processes started by the application must not keep either end open
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        ::close(sockets[0]);
+        ::close(sockets[1]);
+        return false;
+    }
+
+    // Each new worker process returns from here as well - the spawner never
+    // returns
+    if (pid == 0) {
+        ::close(sockets[0]);
+        return runSpawner(sockets[1]);
+    }
+
+    ::close(sockets[1]);
+
+    spawner.pid = pid;
+    spawner.socket = sockets[0];
+    spawner.notifier = new QSocketNotifier(sockets[0], QSocketNotifier::Read, this);
+    connect(spawner.notifier, &QSocketNotifier::activated, this, &ProcessPool::onSpawnerMessage);
+
+    for (int i = 0; i < size; ++i) {
+        spawn(i);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ProcessPool::stop()
+{
+    stopping = true;
+
+#if defined(Q_OS_UNIX)
+    // Only the direction towards the worker processes is shut down - the
+    // supervisor still needs to learn when each of them exits
+    foreach (const Process &process, processes) {
+        if (process.socket != -1) {
+            shutdown(process.socket, SHUT_WR);
+        }
+    }
+#endif
+}
+
+void ProcessPool::kill()
+{
+#if defined(Q_OS_UNIX)
+    foreach (const Process &process, processes) {
+        if (process.pid > 0) {
+            ::kill(process.pid, SIGKILL);
+        }
+    }
+#endif
+}
+
+bool ProcessPool::isSupervisor() const
+{
+    return supervisor;
+}
+
+int ProcessPool::count() const
+{
+    int count = 0;
+    foreach (const Process &process, processes) {
+        if (process.pid) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QList<Server::ProcessStatistics> ProcessPool::statistics() const
+{
+    QList<Server::ProcessStatistics> list;
+    for (int i = 0; counters && i < size; ++i) {
+        const Counters &slot = counters[i];
+        Server::ProcessStatistics statistics;
+        statistics.pid = slot.pid.load();
+        if (statistics.pid) {
+            statistics.requestCount = slot.requestCount.load();
+            statistics.bytesWritten = slot.bytesWritten.load();
+            statistics.connectionCount = slot.connectionCount.load();
+            list.append(statistics);
+        }
+    }
+    return list;
+}
+
+bool ProcessPool::runSpawner(int socket)
+{
+#if defined(Q_OS_UNIX)
+    supervisor = false;
+
+    // The spawner never runs the event loop it was forked from
+    QVector<qint64> pids(size, 0);
+    forever {
+
+        // Let the supervisor know about every worker process that exited -
+        // the slot is cleared right away so that statistics() is accurate
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            int index = pids.indexOf(pid);
+            if (index != -1) {
+                pids[index] = 0;
+                counters[index].pid.store(0);
+                counters[index].connectionCount.store(0);
+
+                Message message = {Message::ProcessExited, index, pid, status};
+                sendMessage(socket, message);
+            }
+        }
+
+        pollfd pfd;
+        pfd.fd = socket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, ReapInterval) <= 0) {
+            continue;
+        }
+
+        // Nothing is left to do once the supervisor closes the channel - its
+        // worker processes notice by themselves
+        Message request;
+        int fd;
+        if (!receiveMessage(socket, &request, &fd)) {
+            break;
+        }
+        if (request.type != Message::SpawnRequest || request.index < 0 || request.index >= size) {
+            continue;
+        }
+
+        Message reply = {Message::SpawnReply, request.index, 0, 0};
+
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+            sendMessage(socket, reply);
+            continue;
+        }
+        fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+        fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+
+        // The new process starts without connections
+        counters[request.index].connectionCount.store(0);
+
+        pid = fork();
+        if (pid == 0) {
+            ::close(socket);
+            ::close(sockets[0]);
+            becomeWorker(request.index, sockets[1]);
+            return true;
+        }
+
+        if (pid != -1) {
+            pids[request.index] = pid;
+            counters[request.index].pid.store(pid);
+            reply.pid = pid;
+        }
+        sendMessage(socket, reply, pid == -1 ? -1 : sockets[0]);
+
+        ::close(sockets[0]);
+        ::close(sockets[1]);
+    }
+
+    // Nothing the spawner inherited may be cleaned up by it
+    ::_exit(0);
+#else
+    Q_UNUSED(socket);
+    return false;
+#endif
+}
+
+void ProcessPool::spawn(int index)
+{
+#if defined(Q_OS_UNIX)
+    Message request = {Message::SpawnRequest, index, 0, 0};
+    if (sendMessage(spawner.socket, request)) {
+        processes[index].pid = -1;
+    }
+#else
+    Q_UNUSED(index);
+#endif
+}
+
+void ProcessPool::restart(int index)
+{
+    QTimer::singleShot(RestartInterval, this, [this, index]() {
+        if (!stopping) {
+            spawn(index);
+        }
+    });
+}
+
+void ProcessPool::becomeWorker(int index, int socket)
+{
+    channel.socket = socket;
+    channel.notifier = new QSocketNotifier(socket, QSocketNotifier::Read, this);
+    connect(channel.notifier, &QSocketNotifier::activated, this, &ProcessPool::onSupervisorExited);
+
+    Q_EMIT workerStarted(counters + index);
+}
+
+void ProcessPool::closeChannel(Process &process)
+{
+    // The notifier may be the one that reported the channel as closed
+    if (process.notifier) {
+        process.notifier->setEnabled(false);
+        process.notifier->deleteLater();
+        process.notifier = 0;
+    }
+
+#if defined(Q_OS_UNIX)
+    if (process.socket != -1) {
+        ::close(process.socket);
+        process.socket = -1;
+    }
+#endif
+}
+
+void ProcessPool::onSpawnerMessage()
+{
+#if defined(Q_OS_UNIX)
+    Message message;
+    int fd;
+    if (!receiveMessage(spawner.socket, &message, &fd)) {
+
+        // Without the spawner, no worker process can be replaced - the ones
+        // that are running carry on
+        closeChannel(spawner);
+        waitpid(spawner.pid, 0, WNOHANG);
+        return;
+    }
+    if (message.index < 0 || message.index >= size) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return;
+    }
+
+    Process &process = processes[message.index];
+    switch (message.type) {
+    case Message::SpawnReply:
+        if (fd == -1) {
+            process.pid = 0;
+            restart(message.index);
+            Q_EMIT processExited();
+            break;
+        }
+        process.pid = message.pid;
+        process.socket = fd;
+        process.started.start();
+
+        // A process that was spawned while stopping stops right away
+        if (stopping) {
+            shutdown(fd, SHUT_WR);
+        }
+        break;
+    case Message::ProcessExited:
+        if (fd != -1) {
+            ::close(fd);
+        }
+        onProcessExited(message.index, message.status);
+        break;
+    default:
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+#endif
+}
+
+void ProcessPool::onProcessExited(int index, int status)
+{
+#if defined(Q_OS_UNIX)
+    Process &process = processes[index];
+    closeChannel(process);
+    process.pid = 0;
+
+    // A worker process that exits normally was asked to, so only one that
+    // crashed is replaced - the replacement continues to count for the slot
+    bool crashed = WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status));
+    if (crashed && !stopping) {
+        if (process.started.elapsed() < RestartInterval) {
+            restart(index);
+        } else {
+            spawn(index);
+        }
+    }
+
+    Q_EMIT processExited();
+#else
+    Q_UNUSED(index);
+    Q_UNUSED(status);
+#endif
+}
+
+void ProcessPool::onSupervisorExited()
+{
+    // The channel remains open until the process exits - the notifier would
+    // otherwise keep reporting EOF
+    channel.notifier->setEnabled(false);
+    Q_EMIT supervisorExited();
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_PROCESSPOOL_H
+#define QHTTPENGINE_PROCESSPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+#include <qhttpengine/server.h>
+
+class QSocketNotifier;
+
+namespace QHttpEngine
+{
+
+struct Counters;
+
+/**
+ * @brief Worker processes forked from a server
+ *
+ * The worker processes are not forked by the supervisor itself - a process
+ * forked from a Qt event loop would share the state of the loop with it -
+ * but by a spawner process that the pool forks when it is started, before
+ * the event loop runs. The spawner does nothing but wait for the supervisor
+ * to ask for a worker process, fork it and report back its pid and once it
+ * has exited. Each worker process thereby starts out as a copy of the
+ * process at the time the pool was started, inherits the listening socket
+ * and accepts connections from it on its own. The process that created the
+ * pool becomes the supervisor - it no longer accepts connections and instead
+ * asks for a replacement for any worker process that crashes.
+ *
+ * The supervisor and each worker process are connected by a socket pair
+ * that neither of them ever writes to. A worker process notices that the
+ * supervisor is stopping or has died when its end reports EOF. The spawner
+ * reaps the worker processes and exits once the supervisor closes its own
+ * channel, so no process has to handle signals and the supervisor never
+ * blocks waiting for another process.
+ *
+ * The counters for every process are kept in an anonymous shared mapping
+ * created before the spawner is forked, with a slot for each process.
+ */
+class ProcessPool : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    ProcessPool(int size, QObject *parent = 0);
+    ~ProcessPool();
+
+    bool start();
+    void stop();
+    void kill();
+
+    bool isSupervisor() const;
+    int count() const;
+
+    QList<Server::ProcessStatistics> statistics() const;
+
+Q_SIGNALS:
+
+    // Emitted in a new worker process with the counters it should update
+    void workerStarted(Counters *counters);
+
+    // Emitted in a worker process once the supervisor stops or dies
+    void supervisorExited();
+
+    // Emitted in the supervisor once a worker process has exited
+    void processExited();
+
+private:
+
+    struct Process
+    {
+        // 0 if there is no process and -1 while it is being spawned
+        qint64 pid;
+        int socket;
+        QSocketNotifier *notifier;
+        QElapsedTimer started;
+    };
+
+    bool runSpawner(int socket);
+    void spawn(int index);
+    void restart(int index);
+    void becomeWorker(int index, int socket);
+    void closeChannel(Process &process);
+
+    void onSpawnerMessage();
+    void onProcessExited(int index, int status);
+    void onSupervisorExited();
+
+    const int size;
+    Counters *counters;
+
+    // Worker processes indexed by their slot (supervisor only)
+    QVector<Process> processes;
+
+    // Channel to the spawner (supervisor only)
+    Process spawner;
+
+    // End of the socket pair held by a worker process
+    Process channel;
+
+    bool supervisor;
+    bool stopping;
+};
+
+}
+
+#endif // QHTTPENGINE_PROCESSPOOL_H
@@ -42,9 +42,6 @@ ProxyHandler::ProxyHandler(const QHostAddress &address, quint16 port, QObject *p
 
 void ProxyHandler::process(Socket *socket, const QString &path)
 {
-    // Parent the socket to the proxy
-    socket->setParent(this);
-
-    // Create a new proxy socket
+    // Create a new proxy socket - it is destroyed along with the socket
     new ProxySocket(socket, path, d->address, d->port);
 }
@@ -31,9 +31,11 @@ ProxySocket::ProxySocket(Socket *socket, const QString &path, const QHostAddress
       mDownstreamSocket(socket),
       mPath(path),
       mHeadersParsed(false),
-      mHeadersWritten(false)
+      mHeadersWritten(false),
+      mChunked(IByteArray(socket->header(HeaderList::TransferEncoding)).contains("chunked"))
 {
     connect(mDownstreamSocket, &Socket::readyRead, this, &ProxySocket::onDownstreamReadyRead);
+    connect(mDownstreamSocket, &Socket::readChannelFinished, this, &ProxySocket::onDownstreamReadChannelFinished);
     connect(mDownstreamSocket, &Socket::disconnected, this, &ProxySocket::onDownstreamDisconnected);
 
     connect(&mUpstreamSocket, &QTcpSocket::connected, this, &ProxySocket::onUpstreamConnected);
@@ -50,10 +52,26 @@ ProxySocket::ProxySocket(Socket *socket, const QString &path, const QHostAddress
 
 void ProxySocket::onDownstreamReadyRead()
 {
-    if (mHeadersWritten) {
-        mUpstreamSocket.write(mDownstreamSocket->readAll());
-    } else {
-        mUpstreamWrite.append(mDownstreamSocket->readAll());
+    // Forward the body in the pieces it was received in without copying it
+    for (QByteArray data = mDownstreamSocket->readSegment(); data.size(); data = mDownstreamSocket->readSegment()) {
+
+        // The downstream socket decodes a chunked request body, so it must be
+        // encoded again before being sent upstream
+        if (mChunked) {
+            writeUpstream(QByteArray::number(data.size(), 16) + "\r\n");
+            writeUpstream(data);
+            writeUpstream("\r\n");
+        } else {
+            writeUpstream(data);
+        }
+    }
+}
+
+void ProxySocket::onDownstreamReadChannelFinished()
+{
+    // Write the last chunk of a chunked request body
+    if (mChunked) {
+        writeUpstream("0\r\n\r\n");
     }
 }
 
@@ -72,24 +90,51 @@ void ProxySocket::onUpstreamConnected()
             .toUtf8()
     );
 
-    // Use the existing headers but insert proxy-related ones
-    Socket::HeaderMap headers = mDownstreamSocket->headers();
+    // Use the existing headers but replace proxy-related ones - the
+    // connection options apply to the downstream connection only, the
+    // client was already told to send the body (so the upstream server must
+    // not send an interim response) and a chunked body must not also specify
+    // its length
+    const HeaderList &headers = mDownstreamSocket->headerList();
+    QByteArray data;
+    for (int i = 0; i < headers.count(); ++i) {
+        switch (headers.idAt(i)) {
+        case HeaderList::Connection:
+        case HeaderList::Expect:
+        case HeaderList::KeepAlive:
+        case HeaderList::XForwardedFor:
+            continue;
+        case HeaderList::ContentLength:
+            if (mChunked) {
+                continue;
+            }
+            break;
+        default:
+            break;
+        }
+        data.append(headers.nameAt(i) + ": " + headers.valueAt(i) + "\r\n");
+    }
+
+    // Insert proxy-related headers
     QByteArray peerIP = mDownstreamSocket->peerAddress().toString().toUtf8();
-    QByteArray origFwd = headers.value("X-Forwarded-For");
+    QByteArray origFwd = headers.value(HeaderList::XForwardedFor);
     if (origFwd.isNull()) {
-        headers.insert("X-Forwarded-For", peerIP);
+        data.append("X-Forwarded-For: " + peerIP + "\r\n");
     } else {
-        headers.insert("X-Forwarded-For", origFwd + ", " + peerIP);
+        data.append("X-Forwarded-For: " + origFwd + ", " + peerIP + "\r\n");
     }
-    if (!headers.contains("X-Real-IP")) {
-        headers.insert("X-Real-IP", peerIP);
+    if (!headers.contains(HeaderList::XRealIP)) {
+        data.append("X-Real-IP: " + peerIP + "\r\n");
     }
 
+    // The upstream connection is used for a single request, which also
+    // allows the end of a response without a Content-Length header to be
+    // detected
+    data.append("Connection: close\r\n");
+
     // Write the headers to the socket with the terminating CRLF
-    for (auto i = headers.constBegin(); i != headers.constEnd(); ++i) {
-        mUpstreamSocket.write(i.key() + ": " + i.value() + "\r\n");
-    }
-    mUpstreamSocket.write("\r\n");
+    data.append("\r\n");
+    mUpstreamSocket.write(data);
     mHeadersWritten = true;
 
     // If there is any data buffered for writing, write it
@@ -120,6 +165,10 @@ void ProxySocket::onUpstreamReadyRead()
                 return;
             }
 
+            // The downstream socket manages its own connection options
+            headers.remove("Connection");
+            headers.remove("Keep-Alive");
+
             // Dump the headers back downstream
             mDownstreamSocket->setStatusCode(statusCode, statusReason);
             mDownstreamSocket->setHeaders(headers);
@@ -129,6 +178,14 @@ void ProxySocket::onUpstreamReadyRead()
             // Remember that headers were parsed and empty the buffer
             mHeadersParsed = true;
             mUpstreamRead.clear();
+
+            // The response to a HEAD request has no body, so there is no
+            // need to wait for the upstream server to close the connection
+            if (mDownstreamSocket->method() == Socket::HEAD) {
+                mUpstreamSocket.disconnect(this);
+                mUpstreamSocket.abort();
+                mDownstreamSocket->close();
+            }
         }
     } else {
         mDownstreamSocket->write(mUpstreamSocket.readAll());
@@ -144,6 +201,15 @@ void ProxySocket::onUpstreamError(QAbstractSocket::SocketError socketError)
     }
 }
 
+void ProxySocket::writeUpstream(const QByteArray &data)
+{
+    if (mHeadersWritten) {
+        mUpstreamSocket.write(data);
+    } else {
+        mUpstreamWrite.append(data);
+    }
+}
+
 QString ProxySocket::methodToString(Socket::Method method) const
 {
     switch (method) {
@@ -47,6 +47,7 @@ public:
 private Q_SLOTS:
 
     void onDownstreamReadyRead();
+    void onDownstreamReadChannelFinished();
     void onDownstreamDisconnected();
 
     void onUpstreamConnected();
@@ -56,6 +57,7 @@ private Q_SLOTS:
 private:
 
     QString methodToString(QHttpEngine::Socket::Method method) const;
+    void writeUpstream(const QByteArray &data);
 
     QHttpEngine::Socket *mDownstreamSocket;
     QTcpSocket mUpstreamSocket;
@@ -63,6 +65,7 @@ private:
     QString mPath;
     bool mHeadersParsed;
     bool mHeadersWritten;
+    bool mChunked;
 
     QByteArray mUpstreamRead;
     QByteArray mUpstreamWrite;
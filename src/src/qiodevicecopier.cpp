@@ -24,6 +24,7 @@
 #include <QTimer>
 
 #include <qhttpengine/qiodevicecopier.h>
+#include <qhttpengine/socket.h>
 
 #include "qiodevicecopier_p.h"
 
@@ -34,16 +35,29 @@ const qint64 DefaultBufferSize = 65536;
 
 QIODeviceCopierPrivate::QIODeviceCopierPrivate(QIODeviceCopier *copier, QIODevice *srcDevice, QIODevice *destDevice)
     : QObject(copier),
-      q(copier),
       src(srcDevice),
       dest(destDevice),
+      destSocket(qobject_cast<Socket*>(destDevice)),
+      waitingForDrain(false),
       bufferSize(DefaultBufferSize),
       rangeFrom(0),
-      rangeTo(-1)
+      rangeTo(-1),
+      q(copier)
 {
 }
 
 void QIODeviceCopierPrivate::onReadyRead()
+{
+    // Leave the data in the source device until the client catches up
+    if (destSocket && !destSocket->canWrite()) {
+        waitingForDrain = true;
+        return;
+    }
+
+    copyAvailable();
+}
+
+void QIODeviceCopierPrivate::copyAvailable()
 {
     if (dest->write(src->readAll()) == -1) {
         Q_EMIT q->error(dest->errorString());
@@ -53,9 +67,12 @@ void QIODeviceCopierPrivate::onReadyRead()
 
 void QIODeviceCopierPrivate::onReadChannelFinished()
 {
-    // Read any data that remains and signal the end of the operation
+    // Read any data that remains (regardless of whether the destination is
+    // ready for it, since no more will arrive) and signal the end of the
+    // operation
+    waitingForDrain = false;
     if (src->bytesAvailable()) {
-        onReadyRead();
+        copyAvailable();
     }
 
     Q_EMIT q->finished();
@@ -91,13 +108,30 @@ void QIODeviceCopierPrivate::nextBlock()
     // Check if the end of the device has been reached or if the end of
     // the requested range is reached - if so, emit the finished signal and
     // if not, continue to read data at the next iteration of the event loop
+    // (or once the client has received enough of the data written so far)
     if (src->atEnd() || (rangeTo != -1 && src->pos() > rangeTo)) {
         Q_EMIT q->finished();
+    } else if (destSocket && !destSocket->canWrite()) {
+        waitingForDrain = true;
     } else {
         QTimer::singleShot(0, this, &QIODeviceCopierPrivate::nextBlock);
     }
 }
 
+void QIODeviceCopierPrivate::onWriteBufferDrained()
+{
+    if (!waitingForDrain) {
+        return;
+    }
+    waitingForDrain = false;
+
+    if (src->isSequential()) {
+        onReadyRead();
+    } else {
+        nextBlock();
+    }
+}
+
 QIODeviceCopier::QIODeviceCopier(QIODevice *src, QIODevice *dest, QObject *parent)
     : QObject(parent),
       d(new QIODeviceCopierPrivate(this, src, dest))
@@ -153,6 +187,12 @@ void QIODeviceCopier::start()
     connect(d->src, &QIODevice::readyRead, d, &QIODeviceCopierPrivate::onReadyRead);
     connect(d->src, &QIODevice::readChannelFinished, d, &QIODeviceCopierPrivate::onReadChannelFinished);
 
+    // Reading resumes when a socket that was unable to accept more data
+    // becomes ready again
+    if (d->destSocket) {
+        connect(d->destSocket, &Socket::writeBufferDrained, d, &QIODeviceCopierPrivate::onWriteBufferDrained);
+    }
+
     // The first read from the device needs to be triggered
     QTimer::singleShot(0, d, d->src->isSequential() ?
             &QIODeviceCopierPrivate::onReadyRead :
@@ -163,6 +203,7 @@ void QIODeviceCopier::stop()
 {
     disconnect(d->src, &QIODevice::readyRead, d, &QIODeviceCopierPrivate::onReadyRead);
     disconnect(d->src, &QIODevice::readChannelFinished, d, &QIODeviceCopierPrivate::onReadChannelFinished);
+    d->waitingForDrain = false;
 
     Q_EMIT finished();
 }
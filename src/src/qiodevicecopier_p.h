@@ -31,6 +31,7 @@ namespace QHttpEngine
 {
 
 class QIODeviceCopier;
+class Socket;
 
 class QIODeviceCopierPrivate : public QObject
 {
@@ -43,6 +44,11 @@ public:
     QIODevice *const src;
     QIODevice *const dest;
 
+    // Set when the destination is an HTTP socket so that the copier can
+    // wait for the client to receive data before reading more
+    Socket *const destSocket;
+    bool waitingForDrain;
+
     qint64 bufferSize;
 
     qint64 rangeFrom;
@@ -54,9 +60,12 @@ public Q_SLOTS:
     void onReadChannelFinished();
 
     void nextBlock();
+    void onWriteBufferDrained();
 
 private:
 
+    void copyAvailable();
+
     QIODeviceCopier *const q;
 };
 
@@ -63,9 +63,10 @@ void QObjectHandlerPrivate::invokeSlot(Socket *socket, Method m)
             return;
         }
 
-        // Invoke the method
+        // Invoke the method - always on the thread of the socket, even if
+        // the receiver lives on another one
         if (!m.receiver->metaObject()->method(index).invoke(
-                    m.receiver, Q_ARG(Socket*, socket))) {
+                    m.receiver, Qt::DirectConnection, Q_ARG(Socket*, socket))) {
             socket->writeError(Socket::InternalServerError);
             return;
         }
@@ -88,9 +89,19 @@ void QObjectHandler::process(Socket *socket, const QString &path)
 
     QObjectHandlerPrivate::Method m = d->map.value(path);
 
+    // Apply the limit for the body (if any) before waiting for it - the
+    // socket is closed if the body is already known to be too large
+    if (d->maxBodySizes.contains(path)) {
+        socket->setMaxBodySize(d->maxBodySizes.value(path));
+        if (!socket->isOpen()) {
+            return;
+        }
+    }
+
     // If the slot requires all data to be received, check to see if this is
-    // already the case, otherwise, wait until the rest of it arrives
-    if (!m.readAll || socket->bytesAvailable() >= socket->contentLength()) {
+    // already the case, otherwise, wait until the rest of it arrives - the
+    // length of a chunked body is not known in advance
+    if (!m.readAll || socket->isReadFinished()) {
         d->invokeSlot(socket, m);
     } else {
         connect(socket, &Socket::readChannelFinished, [this, socket, m]() {
@@ -104,6 +115,11 @@ void QObjectHandler::registerMethod(const QString &name, QObject *receiver, cons
     d->map.insert(name, QObjectHandlerPrivate::Method(receiver, method, readAll));
 }
 
+void QObjectHandler::setMaxBodySize(const QString &name, qint64 bytes)
+{
+    d->maxBodySizes.insert(name, bytes);
+}
+
 void QObjectHandler::registerMethodImpl(const QString &name, QObject *receiver, QtPrivate::QSlotObjectBase *slotObj, bool readAll)
 {
     d->map.insert(name, QObjectHandlerPrivate::Method(receiver, slotObj, readAll));
@@ -67,6 +67,9 @@ public:
 
     QMap<QString, Method> map;
 
+    // Limits for the request body that apply to individual methods
+    QMap<QString, qint64> maxBodySizes;
+
 private:
 
     QObjectHandler *const q;
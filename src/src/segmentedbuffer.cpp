@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "segmentedbuffer.h"
+
+using namespace QHttpEngine;
+
+SegmentedBuffer::SegmentedBuffer()
+    : offset(0),
+      total(0)
+{
+}
+
+qint64 SegmentedBuffer::size() const
+{
+    return total;
+}
+
+bool SegmentedBuffer::isEmpty() const
+{
+    return !total;
+}
+
+void SegmentedBuffer::append(const QByteArray &data)
+{
+    if (data.size()) {
+        segments.append(data);
+        total += data.size();
+    }
+}
+
+void SegmentedBuffer::append(const char *data, qint64 len)
+{
+    if (len > 0) {
+        append(QByteArray(data, len));
+    }
+}
+
+QByteArray SegmentedBuffer::peek()
+{
+    if (!total) {
+        return QByteArray();
+    }
+
+    // The first segment is shared unless part of it was already consumed
+    trimFirst();
+    return segments.first();
+}
+
+qint64 SegmentedBuffer::skip(qint64 maxlen)
+{
+    qint64 size = qMin(total, maxlen);
+    if (size > 0) {
+        consume(size);
+    }
+    return size;
+}
+
+qint64 SegmentedBuffer::read(char *data, qint64 maxlen)
+{
+    qint64 size = qMin(total, maxlen);
+
+    // Copy from each segment in turn, starting at the offset into the first
+    qint64 copied = 0;
+    for (int i = 0; copied < size; ++i) {
+        const QByteArray &segment = segments.at(i);
+        int start = i ? 0 : offset;
+        qint64 count = qMin(size - copied, static_cast<qint64>(segment.size() - start));
+        memcpy(data + copied, segment.constData() + start, count);
+        copied += count;
+    }
+
+    consume(size);
+    return size;
+}
+
+QByteArray SegmentedBuffer::read(qint64 maxlen)
+{
+    qint64 size = qMin(total, maxlen);
+
+    // If the data is exactly the first segment, it can be shared
+    if (size && !offset && segments.first().size() == size) {
+        QByteArray data = segments.takeFirst();
+        total -= size;
+        return data;
+    }
+
+    QByteArray data(size, Qt::Uninitialized);
+    read(data.data(), size);
+    return data;
+}
+
+QByteArray SegmentedBuffer::readAll()
+{
+    return read(total);
+}
+
+void SegmentedBuffer::clear()
+{
+    segments.clear();
+    offset = 0;
+    total = 0;
+}
+
+void SegmentedBuffer::trimFirst()
+{
+    // Copy the rest of a partially consumed segment so that it can be shared
+    if (offset) {
+        segments.first() = segments.first().mid(offset);
+        offset = 0;
+    }
+}
+
+void SegmentedBuffer::consume(qint64 len)
+{
+    total -= len;
+
+    // Drop the segments that were consumed in full and advance the offset
+    // into the first one that remains
+    while (len > 0) {
+        qint64 remaining = segments.first().size() - offset;
+        if (len < remaining) {
+            offset += len;
+            return;
+        }
+        len -= remaining;
+        segments.removeFirst();
+        offset = 0;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_SEGMENTEDBUFFER_H
+#define QHTTPENGINE_SEGMENTEDBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace QHttpEngine
+{
+
+/**
+ * @brief Buffer of bytes stored in segments
+ *
+ * Data is appended to the end of the buffer and consumed from the front.
+ * Rather than moving the remaining data each time some of it is consumed,
+ * the buffer keeps a list of the byte arrays that were appended along with
+ * the offset into the first one. Appending a QByteArray shares its data
+ * instead of copying it, so both operations take amortized constant time
+ * (apart from copying the bytes that are read).
+ */
+class SegmentedBuffer
+{
+public:
+
+    SegmentedBuffer();
+
+    qint64 size() const;
+    bool isEmpty() const;
+
+    void append(const QByteArray &data);
+    void append(const char *data, qint64 len);
+
+    QByteArray peek();
+    qint64 skip(qint64 maxlen);
+
+    qint64 read(char *data, qint64 maxlen);
+    QByteArray read(qint64 maxlen);
+    QByteArray readAll();
+
+    void clear();
+
+private:
+
+    void consume(qint64 len);
+    void trimFirst();
+
+    QList<QByteArray> segments;
+    int offset;
+    qint64 total;
+};
+
+}
+
+#endif // QHTTPENGINE_SEGMENTEDBUFFER_H
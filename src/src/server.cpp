@@ -20,36 +20,389 @@
  * IN THE SOFTWARE.
  */
 
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QThread>
+
 #if !defined(QT_NO_SSL)
 #  include <QSslSocket>
 #endif
 
+#if defined(Q_OS_UNIX)
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
 #include <qhttpengine/handler.h>
 #include <qhttpengine/socket.h>
 
+#include "connection.h"
+#include "handover.h"
+#include "locallistener.h"
+#include "processpool.h"
 #include "server_p.h"
+#include "worker.h"
 
 using namespace QHttpEngine;
 
+// Default limits for persistent connections
+const int DefaultMaxRequests = 100;
+const int DefaultIdleTimeout = 5000;
+const int DefaultHeaderTimeout = 10000;
+const int DefaultBodyTimeout = 30000;
+const int DefaultWriteTimeout = 30000;
+const int DefaultMaxPipelinedRequests = 16;
+
+// Default number of connections kept for reuse
+const int DefaultConnectionPoolSize = 64;
+
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+
+// Same backlog that QTcpServer uses for its socket
+const int ListenBacklog = 50;
+
+// Create a socket bound to the address that other sockets may be bound to
+// as well - the kernel spreads incoming connections across those that listen
+static int createReusePortSocket(const QHostAddress &address, quint16 port, bool listening)
+{
+    bool ipv4 = address.protocol() == QAbstractSocket::IPv4Protocol;
+    int fd = ::socket(ipv4 ? AF_INET : AF_INET6, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    int value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
+
+    sockaddr_storage storage;
+    std::memset(&storage, 0, sizeof(storage));
+    socklen_t length;
+
+    if (ipv4) {
+        sockaddr_in *addr = reinterpret_cast<sockaddr_in*>(&storage);
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(port);
+        addr->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length = sizeof(sockaddr_in);
+    } else {
+
+        // QHostAddress::Any accepts IPv4 connections as well
+        int v6only = address == QHostAddress::Any ? 0 : 1;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+
+        sockaddr_in6 *addr = reinterpret_cast<sockaddr_in6*>(&storage);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_port = htons(port);
+        Q_IPV6ADDR ip = address.toIPv6Address();
+        std::memcpy(&addr->sin6_addr, &ip, sizeof(ip));
+        length = sizeof(sockaddr_in6);
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&storage), length) == -1 ||
+            (listening && ::listen(fd, ListenBacklog) == -1)) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+#endif
+
 ServerPrivate::ServerPrivate(Server *httpServer)
     : QObject(httpServer),
-      q(httpServer),
-      handler(0)
+      handler(0),
+      maxRequests(DefaultMaxRequests),
+      idleTimeout(DefaultIdleTimeout),
+      headerTimeout(DefaultHeaderTimeout),
+      bodyTimeout(DefaultBodyTimeout),
+      writeTimeout(DefaultWriteTimeout),
+      maxPipelinedRequests(DefaultMaxPipelinedRequests),
+      maxHeaderSize(DefaultMaxHeaderSize),
+      maxHeaderCount(DefaultMaxHeaderCount),
+      maxBodySize(0),
+      bodyBufferSize(DefaultBodyBufferSize),
+      noDelay(false),
+      corkEnabled(false),
+      connectionPoolSize(DefaultConnectionPoolSize),
+      reusePort(false),
+      maxConnections(0),
+      overloadPolicy(Server::PauseAccepting),
+      acceptPaused(false),
+      localListener(0),
+      draining(false),
+      counters(&localCounters),
+      processPool(0),
+      q(httpServer)
 {
+    drainTimer.setSingleShot(true);
+    connect(&drainTimer, &QTimer::timeout, this, &ServerPrivate::onDrainTimeout);
+
+    setWorkerCount(0);
 }
 
-void ServerPrivate::process(QTcpSocket *socket)
+ServerPrivate::~ServerPrivate()
 {
-    Socket *httpSocket = new Socket(socket, this);
+    for (int i = 0; i < waiting.count(); ++i) {
+        close(waiting.at(i).first, waiting.at(i).second);
+    }
 
-    // Wait until the socket finishes reading the HTTP headers before routing
-    connect(httpSocket, &Socket::headersParsed, [this, httpSocket]() {
-        if (handler) {
-            handler->route(httpSocket, QString(httpSocket->path().mid(1)));
+    stopWorkers();
+}
+
+void ServerPrivate::incoming(qintptr socketDescriptor, Worker::Transport transport)
+{
+    // Accepting may be paused while the kernel is handing over a batch of
+    // connections, so the rest of the batch waits for a free slot too - a
+    // local socket cannot pause accepting, so its connections always wait
+    if (isFull() || waiting.count()) {
+        if (overloadPolicy == Server::PauseAccepting) {
+            waiting.append(qMakePair(socketDescriptor, transport));
+            pauseAccepting();
         } else {
-            httpSocket->writeError(Socket::InternalServerError);
+            reject(socketDescriptor, transport);
+        }
+        return;
+    }
+
+    dispatch(socketDescriptor, transport);
+
+    // Leave further connections in the backlog once the limit is reached
+    if (overloadPolicy == Server::PauseAccepting && isFull()) {
+        pauseAccepting();
+    }
+}
+
+void ServerPrivate::dispatch(qintptr socketDescriptor, Worker::Transport transport)
+{
+    // Hand the connection to the worker with the fewest connections - the
+    // count is increased right away so that a burst of connections is
+    // spread across the workers
+    Worker *worker = workers.first();
+    foreach (Worker *other, workers) {
+        if (other->connectionCount.load() < worker->connectionCount.load()) {
+            worker = other;
+        }
+    }
+    worker->connectionCount.ref();
+
+    if (worker->thread() == thread()) {
+        worker->accept(socketDescriptor, transport);
+    } else {
+        post(worker, [worker, socketDescriptor, transport]() {
+            worker->accept(socketDescriptor, transport);
+        });
+    }
+}
+
+void ServerPrivate::reject(qintptr socketDescriptor, Worker::Transport transport)
+{
+    Worker *worker = workers.first();
+    if (worker->thread() == thread()) {
+        worker->reject(socketDescriptor, transport);
+    } else {
+        post(worker, [worker, socketDescriptor, transport]() {
+            worker->reject(socketDescriptor, transport);
+        });
+    }
+}
+
+void ServerPrivate::close(qintptr socketDescriptor, Worker::Transport transport)
+{
+    if (transport == Worker::LocalTransport) {
+        QLocalSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+    } else {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+    }
+}
+
+void ServerPrivate::pauseAccepting()
+{
+    if (!acceptPaused) {
+        acceptPaused = true;
+        q->pauseAccepting();
+    }
+}
+
+void ServerPrivate::admitWaiting()
+{
+    while (waiting.count() && !isFull()) {
+        QPair<qintptr, Worker::Transport> connection = waiting.takeFirst();
+        dispatch(connection.first, connection.second);
+    }
+
+    // The server may have stopped listening in the meantime
+    if (acceptPaused && !isFull()) {
+        acceptPaused = false;
+        if (q->isListening()) {
+            q->resumeAccepting();
+        }
+    }
+}
+
+void ServerPrivate::configure(Connection *connection) const
+{
+    if (noDelay && connection->tcpSocket) {
+        connection->tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
+
+    connection->setMaxRequests(maxRequests);
+    connection->setIdleTimeout(idleTimeout);
+    connection->setHeaderTimeout(headerTimeout);
+    connection->setBodyTimeout(bodyTimeout);
+    connection->setWriteTimeout(writeTimeout);
+    connection->setMaxPipelinedRequests(maxPipelinedRequests);
+    connection->setMaxHeaderSize(maxHeaderSize);
+    connection->setMaxHeaderCount(maxHeaderCount);
+    connection->setMaxBodySize(maxBodySize);
+    connection->setBodyBufferSize(bodyBufferSize);
+    connection->setCorkEnabled(corkEnabled);
+    connection->setErrorPages(errorPages);
+    connection->setCounters(counters);
+}
+
+void ServerPrivate::setWorkerCount(int count)
+{
+    stopWorkers();
+
+    // Without worker threads, a single worker serves the connections on the
+    // thread of the server
+    if (count <= 0) {
+        workers.append(new Worker(this, this));
+    } else {
+        for (int i = 0; i < count; ++i) {
+            QThread *thread = new QThread(this);
+            Worker *worker = new Worker(this);
+            worker->moveToThread(thread);
+            connect(thread, &QThread::finished, worker, &Worker::deleteLater);
+            thread->start();
+
+            workers.append(worker);
+            threads.append(thread);
         }
-    });
+    }
+
+    foreach (Worker *worker, workers) {
+        connect(worker, &Worker::connectionClosed, this, [this]() {
+            checkDrained();
+            admitWaiting();
+        });
+    }
+}
+
+void ServerPrivate::post(Worker *worker, const std::function<void()> &function)
+{
+    QTimer::singleShot(0, worker, function);
+}
+
+int ServerPrivate::connectionCount() const
+{
+    int count = 0;
+    foreach (Worker *worker, workers) {
+        count += worker->connectionCount.load();
+    }
+    return count;
+}
+
+bool ServerPrivate::isFull() const
+{
+    return maxConnections > 0 && connectionCount() >= maxConnections;
+}
+
+void ServerPrivate::onDrainTimeout()
+{
+    // Any connection that remains is closed without waiting for the rest of
+    // its responses
+    foreach (Worker *worker, workers) {
+        post(worker, [worker]() {
+            worker->abort();
+        });
+    }
+
+    // Worker processes that remain are killed - the supervisor does not wait
+    // for them to exit
+    if (processPool) {
+        processPool->kill();
+    }
+
+    if (draining) {
+        draining = false;
+        Q_EMIT q->drained();
+    }
+}
+
+bool ServerPrivate::forkProcesses(int count)
+{
+    processPool = new ProcessPool(count, this);
+    connect(processPool, &ProcessPool::workerStarted, this, &ServerPrivate::onWorkerStarted);
+    connect(processPool, &ProcessPool::supervisorExited, this, &ServerPrivate::onSupervisorExited);
+    connect(processPool, &ProcessPool::processExited, this, &ServerPrivate::checkDrained);
+
+    // The worker processes inherit the socket and resume accepting from it
+    q->pauseAccepting();
+    if (!processPool->start()) {
+        delete processPool;
+        processPool = 0;
+        q->resumeAccepting();
+        return false;
+    }
+
+    return true;
+}
+
+void ServerPrivate::onWorkerStarted(Counters *workerCounters)
+{
+    // The supervisor stopped accepting connections before forking
+    counters = workerCounters;
+    q->resumeAccepting();
+}
+
+void ServerPrivate::onSupervisorExited()
+{
+    // Without a supervisor, nothing would replace the process if it crashed,
+    // so it finishes its connections and exits
+    connect(q, &Server::drained, QCoreApplication::instance(), &QCoreApplication::quit);
+    q->drain(0);
+}
+
+void ServerPrivate::checkDrained()
+{
+    if (draining && !connectionCount() && !(processPool && processPool->count())) {
+        draining = false;
+        drainTimer.stop();
+        Q_EMIT q->drained();
+    }
+}
+
+void ServerPrivate::stopWorkers()
+{
+    // The connections of the workers are closed without notifying the server
+    foreach (Worker *worker, workers) {
+        disconnect(worker, 0, this, 0);
+    }
+
+    // Each worker is destroyed on its own thread once the thread finishes
+    foreach (QThread *thread, threads) {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    if (threads.isEmpty()) {
+        qDeleteAll(workers);
+    }
+
+    workers.clear();
+    threads.clear();
 }
 
 Server::Server(QObject *parent)
@@ -70,44 +423,346 @@ void Server::setHandler(Handler *handler)
     d->handler = handler;
 }
 
-#if !defined(QT_NO_SSL)
-void Server::setSslConfiguration(const QSslConfiguration &configuration)
+void Server::setMaxRequestsPerConnection(int maxRequests)
 {
-    d->configuration = configuration;
+    d->maxRequests = maxRequests;
 }
-#endif
 
-void Server::incomingConnection(qintptr socketDescriptor)
+void Server::setIdleTimeout(int msec)
 {
-#if !defined(QT_NO_SSL)
-    if (!d->configuration.isNull()) {
+    d->idleTimeout = msec;
+}
 
-        // Initialize the socket with the SSL configuration
-        QSslSocket *socket = new QSslSocket(this);
+void Server::setHeaderTimeout(int msec)
+{
+    d->headerTimeout = msec;
+}
 
-        // Wait until encryption is complete before processing the socket
-        connect(socket, &QSslSocket::encrypted, [this, socket]() {
-            d->process(socket);
-        });
+void Server::setBodyTimeout(int msec)
+{
+    d->bodyTimeout = msec;
+}
 
-        // If an error occurs, delete the socket
-        connect(socket, static_cast<void(QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
-            socket, &QSslSocket::deleteLater);
+void Server::setWriteTimeout(int msec)
+{
+    d->writeTimeout = msec;
+}
+
+void Server::setMaxPipelinedRequests(int maxPipelinedRequests)
+{
+    d->maxPipelinedRequests = maxPipelinedRequests;
+}
+
+void Server::setMaxHeaderSize(int bytes)
+{
+    d->maxHeaderSize = bytes;
+}
+
+void Server::setMaxHeaderCount(int count)
+{
+    d->maxHeaderCount = count;
+}
+
+void Server::setMaxBodySize(qint64 bytes)
+{
+    d->maxBodySize = bytes;
+}
+
+void Server::setBodyBufferSize(qint64 bytes)
+{
+    d->bodyBufferSize = bytes;
+}
+
+void Server::setNoDelay(bool noDelay)
+{
+    d->noDelay = noDelay;
+}
 
-        socket->setSocketDescriptor(socketDescriptor);
-        socket->setSslConfiguration(d->configuration);
-        socket->startServerEncryption();
+void Server::setCorkEnabled(bool corkEnabled)
+{
+    d->corkEnabled = corkEnabled;
+}
 
+void Server::setErrorTemplate(const QString &errorTemplate)
+{
+    if (errorTemplate.isEmpty()) {
+        d->errorPages.clear();
     } else {
+        d->errorPages = QSharedPointer<const ErrorPages>(new ErrorPages(errorTemplate));
+    }
+}
+
+void Server::setConnectionPoolSize(int size)
+{
+    d->connectionPoolSize = size;
+
+    // Workers on other threads must not read the setting of the server
+    foreach (Worker *worker, d->workers) {
+        d->post(worker, [worker, size]() {
+            worker->setPoolSize(size);
+        });
+    }
+}
+
+void Server::setWorkerThreadCount(int count)
+{
+    d->setWorkerCount(count);
+}
+
+void Server::setMaxConnections(int count)
+{
+    d->maxConnections = count;
+    d->admitWaiting();
+}
+
+void Server::setOverloadPolicy(OverloadPolicy policy)
+{
+    d->overloadPolicy = policy;
+}
+
+int Server::connectionCount() const
+{
+    return d->connectionCount();
+}
+
+int Server::waitingConnectionCount() const
+{
+    return d->waiting.count();
+}
+
+qint64 Server::rejectedConnectionCount() const
+{
+    qint64 count = 0;
+    foreach (Worker *worker, d->workers) {
+        count += worker->rejectedCount.load();
+    }
+    return count;
+}
+
+QList<Server::ProcessStatistics> Server::processStatistics() const
+{
+    if (d->processPool) {
+        return d->processPool->statistics();
+    }
+
+    ProcessStatistics statistics;
+    statistics.pid = QCoreApplication::applicationPid();
+    statistics.requestCount = d->counters->requestCount.load();
+    statistics.bytesWritten = d->counters->bytesWritten.load();
+    statistics.connectionCount = d->counters->connectionCount.load();
+
+    return QList<ProcessStatistics>() << statistics;
+}
+
+bool Server::listenReusePort(const QHostAddress &address, quint16 port)
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+
+    // The socket of the server itself reserves the port and reports the
+    // address but does not listen, so that every connection is accepted by
+    // one of the workers
+    int fd = createReusePortSocket(address, port, false);
+    if (fd == -1) {
+        return false;
+    }
+    if (!setSocketDescriptor(fd)) {
+        ::close(fd);
+        return false;
+    }
+    pauseAccepting();
+    d->reusePort = true;
+
+    // The port may have been chosen when the first socket was bound
+    port = serverPort();
+
+    QList<int> descriptors;
+    for (int i = 0; i < d->workers.count(); ++i) {
+        fd = createReusePortSocket(address, port, true);
+        if (fd == -1) {
+            foreach (int descriptor, descriptors) {
+                ::close(descriptor);
+            }
+            close();
+            return false;
+        }
+        descriptors.append(fd);
+    }
+
+    for (int i = 0; i < d->workers.count(); ++i) {
+        Worker *worker = d->workers.at(i);
+        qintptr descriptor = descriptors.at(i);
+        if (worker->thread() == d->thread()) {
+            worker->listen(descriptor);
+        } else {
+            d->post(worker, [worker, descriptor]() {
+                worker->listen(descriptor);
+            });
+        }
+    }
+
+    return true;
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    return false;
 #endif
+}
 
-        QTcpSocket *socket = new QTcpSocket(this);
-        socket->setSocketDescriptor(socketDescriptor);
+bool Server::forkProcesses(int count)
+{
+    // The supervisor would keep accepting from a local socket and the socket
+    // reserving the port for the workers' sockets does not listen
+    if (count <= 0 || !isListening() || !d->threads.isEmpty() || d->processPool || d->localListener ||
+            d->reusePort) {
+        return false;
+    }
 
-        // Process the socket immediately
-        d->process(socket);
+    // The worker processes are copies of this one, which must not be running
+    // its event loop yet (the state of the loop would be shared with them)
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    if (QThread::currentThread()->loopLevel() > 0) {
+        return false;
+    }
+#endif
 
-#if !defined(QT_NO_SSL)
+    return d->forkProcesses(count);
+}
+
+bool Server::isSupervisor() const
+{
+    return d->processPool && d->processPool->isSupervisor();
+}
+
+bool Server::handOver(const QString &path, bool idleConnections)
+{
+    // The socket that reserves the port for the workers' sockets does not
+    // listen, so there would be nothing for the new process to accept from
+    if (!isListening() || d->reusePort) {
+        return false;
+    }
+
+    QSharedPointer<Handover> handover = Handover::connectTo(path);
+    if (!handover || !handover->send(Handover::ListeningSocket, socketDescriptor())) {
+        return false;
+    }
+
+    // The channel is closed once every worker has sent its idle connections
+    // and released it - this happens before the workers start draining
+    if (idleConnections) {
+        foreach (Worker *worker, d->workers) {
+            d->post(worker, [worker, handover]() {
+                worker->handOver(handover);
+            });
+        }
     }
+
+    drain();
+    return true;
+}
+
+bool Server::adoptListeningDescriptor(const QString &path, int msec)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSharedPointer<Handover> handover = Handover::waitFor(path, msec);
+    if (!handover) {
+        return false;
+    }
+
+    // The listening socket comes first and the connections (if any) follow
+    bool adopted = false;
+    Handover::Type type;
+    qintptr socketDescriptor;
+    while ((socketDescriptor = handover->receive(&type, qMax<qint64>(msec - timer.elapsed(), 0))) != -1) {
+        if (type == Handover::ListeningSocket && !adopted) {
+            adopted = setSocketDescriptor(socketDescriptor);
+            if (!adopted) {
+                ServerPrivate::close(socketDescriptor);
+            }
+        } else if (type == Handover::ClientSocket && adopted) {
+            incomingConnection(socketDescriptor);
+        } else {
+            ServerPrivate::close(socketDescriptor);
+        }
+    }
+
+    return adopted;
+}
+
+bool Server::listenLocal(const QString &name)
+{
+    if (d->processPool) {
+        return false;
+    }
+
+    delete d->localListener;
+    d->localListener = new LocalListener(d);
+    if (!d->localListener->listen(name)) {
+        delete d->localListener;
+        d->localListener = 0;
+        return false;
+    }
+
+    return true;
+}
+
+QString Server::localServerName() const
+{
+    return d->localListener ? d->localListener->fullServerName() : QString();
+}
+
+void Server::drain(int msec)
+{
+    if (d->draining) {
+        return;
+    }
+    d->draining = true;
+
+    // Stop accepting new connections - those that were waiting for a free
+    // slot have not sent anything yet, so they can simply be closed
+    close();
+    if (d->localListener) {
+        d->localListener->close();
+    }
+    for (int i = 0; i < d->waiting.count(); ++i) {
+        d->close(d->waiting.at(i).first, d->waiting.at(i).second);
+    }
+    d->waiting.clear();
+    d->acceptPaused = false;
+
+    foreach (Worker *worker, d->workers) {
+        d->post(worker, [worker]() {
+            worker->drain();
+        });
+    }
+
+    if (d->processPool) {
+        d->processPool->stop();
+    }
+
+    if (msec > 0) {
+        d->drainTimer.start(msec);
+    }
+
+    // The signal is emitted once control returns to the event loop, even if
+    // no connections remain
+    QTimer::singleShot(0, d, &ServerPrivate::checkDrained);
+}
+
+bool Server::isDraining() const
+{
+    return d->draining;
+}
+
+#if !defined(QT_NO_SSL)
+void Server::setSslConfiguration(const QSslConfiguration &configuration)
+{
+    d->configuration = configuration;
+}
 #endif
+
+void Server::incomingConnection(qintptr socketDescriptor)
+{
+    d->incoming(socketDescriptor, Worker::TcpTransport);
 }
@@ -23,8 +23,13 @@
 #ifndef QHTTPENGINE_SERVER_P_H
 #define QHTTPENGINE_SERVER_P_H
 
+#include <functional>
+
+#include <QList>
 #include <QObject>
-#include <QTcpSocket>
+#include <QPair>
+#include <QSharedPointer>
+#include <QTimer>
 
 #if !defined(QT_NO_SSL)
 #  include <QSslConfiguration>
@@ -32,10 +37,19 @@
 
 #include <qhttpengine/server.h>
 
+#include "counters.h"
+#include "errorpages.h"
+#include "worker.h"
+
+class QThread;
+
 namespace QHttpEngine
 {
 
+class Connection;
 class Handler;
+class LocalListener;
+class ProcessPool;
 
 class ServerPrivate : public QObject
 {
@@ -44,17 +58,91 @@ class ServerPrivate : public QObject
 public:
 
     explicit ServerPrivate(Server *httpServer);
+    virtual ~ServerPrivate();
+
+    void incoming(qintptr socketDescriptor, Worker::Transport transport);
+    void dispatch(qintptr socketDescriptor, Worker::Transport transport = Worker::TcpTransport);
+    void reject(qintptr socketDescriptor, Worker::Transport transport = Worker::TcpTransport);
+    static void close(qintptr socketDescriptor, Worker::Transport transport = Worker::TcpTransport);
+    void configure(Connection *connection) const;
+    void setWorkerCount(int count);
+    void pauseAccepting();
+    void admitWaiting();
+    void checkDrained();
+    bool forkProcesses(int count);
+
+    // Invoke the function on the thread of the worker
+    void post(Worker *worker, const std::function<void()> &function);
 
-    void process(QTcpSocket *socket);
+    int connectionCount() const;
+    bool isFull() const;
 
     Handler *handler;
 
+    int maxRequests;
+    int idleTimeout;
+    int headerTimeout;
+    int bodyTimeout;
+    int writeTimeout;
+    int maxPipelinedRequests;
+    int maxHeaderSize;
+    int maxHeaderCount;
+    qint64 maxBodySize;
+    qint64 bodyBufferSize;
+    bool noDelay;
+    bool corkEnabled;
+    int connectionPoolSize;
+
+    // Error responses rendered from the custom template (if one was set)
+    QSharedPointer<const ErrorPages> errorPages;
+
+    // Workers that serve the connections and the threads they run on (if
+    // the server does not serve them on its own thread)
+    QList<Worker*> workers;
+    QList<QThread*> threads;
+
+    // Whether each worker listens with a socket of its own - the socket of
+    // the server then only reserves the port and does not listen
+    bool reusePort;
+
+    // Limit for the number of connections and what happens beyond it -
+    // connections accepted while the server was at the limit wait for a
+    // free slot without being read from
+    int maxConnections;
+    Server::OverloadPolicy overloadPolicy;
+    bool acceptPaused;
+    QList<QPair<qintptr, Worker::Transport> > waiting;
+
+    // Local socket that connections are accepted from as well (if any)
+    LocalListener *localListener;
+
+    // Whether the server is waiting for the connections to close and the
+    // deadline for them to do so
+    bool draining;
+    QTimer drainTimer;
+
+    // Counters updated by the workers - these belong to the process itself
+    // unless it is a worker process forked by the server
+    Counters localCounters;
+    Counters *counters;
+
+    // Worker processes forked from the server (if any)
+    ProcessPool *processPool;
+
 #if !defined(QT_NO_SSL)
     QSslConfiguration configuration;
 #endif
 
+private Q_SLOTS:
+
+    void onDrainTimeout();
+    void onWorkerStarted(Counters *workerCounters);
+    void onSupervisorExited();
+
 private:
 
+    void stopWorkers();
+
     Server *const q;
 };
 
@@ -20,107 +20,211 @@
  * IN THE SOFTWARE.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QTcpSocket>
+#include <QTimer>
 
 #include <qhttpengine/parser.h>
 
+#include "connection.h"
 #include "socket_p.h"
 
 using namespace QHttpEngine;
 
-// Predefined error response requires a simple HTML template to be returned to
-// the client describing the error condition
-const QString ErrorTemplate =
-        "<!DOCTYPE html>"
-        "<html>"
-          "<head>"
-            "<meta charset=\"utf-8\">"
-            "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">"
-            "<title>%1 %2</title>"
-          "</head>"
-          "<body>"
-            "<h1>%1 %2</h1>"
-            "<p>"
-              "An error has occurred while trying to display the requested resource. "
-              "Please contact the website owner if this error persists."
-            "</p>"
-            "<hr>"
-            "<p><em>QHttpEngine %3</em></p>"
-          "</body>"
-        "</html>";
-
-SocketPrivate::SocketPrivate(Socket *httpSocket, QTcpSocket *tcpSocket)
+// Maximum length of a line containing the size of a chunk (along with any
+// extensions) or a trailer in a chunked request body
+const int MaxChunkLineLength = 4096;
+
+// Largest amount of body data that is combined with the response headers
+// into a single write
+const qint64 MaxCoalescedSize = 16384;
+
+// Default limits for the amount of data waiting to be written
+const qint64 DefaultWriteHighWatermark = 262144;
+const qint64 DefaultWriteLowWatermark = 65536;
+
+// The table of predefined reasons must match the constants in Socket
+#define QHTTPENGINE_CHECK_STATUS(name, code, reason) \
+    Q_STATIC_ASSERT(Socket::name == code);
+QHTTPENGINE_STATUS_CODES(QHTTPENGINE_CHECK_STATUS)
+#undef QHTTPENGINE_CHECK_STATUS
+
+// Determine the length of the request body from its Content-Length headers -
+// each value (including each item of a list) must consist of digits alone and
+// all of them must agree, since anything else leaves it unclear where the
+// next request on the connection begins
+static bool parseContentLength(const HeaderList &headers, qint64 &length)
+{
+    const qint64 maxLength = std::numeric_limits<qint64>::max();
+
+    length = -1;
+    for (int i = 0; i < headers.count(); ++i) {
+        if (headers.idAt(i) != HeaderList::ContentLength) {
+            continue;
+        }
+        foreach (const QByteArray &item, headers.valueAt(i).split(',')) {
+            QByteArray digits = item.trimmed();
+            if (digits.isEmpty()) {
+                return false;
+            }
+            qint64 value = 0;
+            for (int j = 0; j < digits.size(); ++j) {
+                int digit = digits.at(j) - '0';
+                if (digit < 0 || digit > 9 || value > (maxLength - digit) / 10) {
+                    return false;
+                }
+                value = value * 10 + digit;
+            }
+            if (length != -1 && length != value) {
+                return false;
+            }
+            length = value;
+        }
+    }
+    return true;
+}
+
+// Check the codings listed by the Transfer-Encoding headers of a request -
+// the body is only framed by chunked encoding if it is the last coding, so
+// any other list leaves the end of the body unknown. The status code for the
+// error is returned or 0 if the codings are acceptable
+static int parseTransferEncoding(const HeaderList &headers, bool &chunked)
+{
+    chunked = false;
+    bool present = false;
+    for (int i = 0; i < headers.count(); ++i) {
+        if (headers.idAt(i) != HeaderList::TransferEncoding) {
+            continue;
+        }
+        present = true;
+        foreach (const QByteArray &item, headers.valueAt(i).split(',')) {
+            IByteArray coding = item.left(item.indexOf(';')).trimmed();
+            if (coding.isEmpty()) {
+                continue;
+            }
+
+            // Nothing may follow chunked encoding
+            if (chunked) {
+                return Socket::BadRequest;
+            }
+            if (coding == "chunked") {
+                chunked = true;
+            } else if (coding != "gzip" && coding != "x-gzip" && coding != "deflate" &&
+                    coding != "compress" && coding != "x-compress") {
+                return Socket::NotImplemented;
+            }
+        }
+    }
+    return present && !chunked ? Socket::BadRequest : 0;
+}
+
+// Remove data from the front of the buffer - if all of it is removed, the
+// buffer is cleared instead so that the next data assigned to it is shared
+// rather than copied
+static void removeFront(QByteArray &buffer, int len)
+{
+    if (len >= buffer.size()) {
+        buffer.clear();
+    } else if (len > 0) {
+        buffer.remove(0, len);
+    }
+}
+
+SocketPrivate::SocketPrivate(Socket *httpSocket, Connection *httpConnection)
     : QObject(httpSocket),
-      q(httpSocket),
-      socket(tcpSocket),
+      connection(httpConnection),
       readState(ReadHeaders),
+      requestPathValid(false),
+      requestQueryStringValid(false),
+      requestHeaderMapValid(false),
       requestDataRead(0),
       requestDataTotal(-1),
+      maxBodySize(httpConnection->maxBodySize()),
+      headerScanned(0),
+      headerLines(0),
+      requestChunked(false),
+      chunkState(ChunkSize),
+      chunkRemaining(0),
+      keepAlive(false),
+      continueExpected(false),
+      continueRemaining(0),
       writeState(WriteNone),
       responseStatusCode(200),
-      responseStatusReason(statusReason(200))
+      responseStatusReason(statusReason(200)),
+      writePending(0),
+      writeHighWatermark(DefaultWriteHighWatermark),
+      writeLowWatermark(DefaultWriteLowWatermark),
+      writeBlocked(false),
+      responseChunked(false),
+      q(httpSocket)
 {
-    socket->setParent(this);
-
-    connect(socket, &QTcpSocket::readyRead, this, &SocketPrivate::onReadyRead);
-    connect(socket, &QTcpSocket::bytesWritten, this, &SocketPrivate::onBytesWritten);
-    connect(socket, &QTcpSocket::readChannelFinished, this, &SocketPrivate::onReadChannelFinished);
-    connect(socket, &QTcpSocket::disconnected, q, &Socket::disconnected);
+    readBuffer.setMaxMemorySize(httpConnection->bodyBufferSize());
+}
 
-    // Process anything already received by the socket
-    onReadyRead();
+QByteArray SocketPrivate::statusReason(int statusCode)
+{
+    switch (statusCode) {
+#define QHTTPENGINE_STATUS_REASON(name, code, reason) \
+    case code: return QByteArrayLiteral(reason);
+    QHTTPENGINE_STATUS_CODES(QHTTPENGINE_STATUS_REASON)
+#undef QHTTPENGINE_STATUS_REASON
+    default: return QByteArrayLiteral("UNKNOWN ERROR");
+    }
 }
 
-QByteArray SocketPrivate::statusReason(int statusCode) const
+QByteArray SocketPrivate::statusLine(int statusCode)
 {
+    // The complete status line for each of the predefined reasons is a
+    // constant, so none of them are built at runtime
     switch (statusCode) {
-    case Socket::OK: return "OK";
-    case Socket::Created: return "CREATED";
-    case Socket::Accepted: return "ACCEPTED";
-    case Socket::PartialContent: return "PARTIAL CONTENT";
-    case Socket::MovedPermanently: return "MOVED PERMANENTLY";
-    case Socket::Found: return "FOUND";
-    case Socket::BadRequest: return "BAD REQUEST";
-    case Socket::Unauthorized: return "UNAUTHORIZED";
-    case Socket::Forbidden: return "FORBIDDEN";
-    case Socket::NotFound: return "NOT FOUND";
-    case Socket::MethodNotAllowed: return "METHOD NOT ALLOWED";
-    case Socket::Conflict: return "CONFLICT";
-    case Socket::BadGateway: return "BAD GATEWAY";
-    case Socket::ServiceUnavailable: return "SERVICE UNAVAILABLE";
-    case Socket::InternalServerError: return "INTERNAL SERVER ERROR";
-    case Socket::HttpVersionNotSupported: return "HTTP VERSION NOT SUPPORTED";
-    default: return "UNKNOWN ERROR";
-    }
-}
-
-void SocketPrivate::onReadyRead()
-{
-    // Append all of the new data to the read buffer
-    readBuffer.append(socket->readAll());
+#define QHTTPENGINE_STATUS_LINE(name, code, reason) \
+    case code: return QByteArrayLiteral("HTTP/1.1 " #code " " reason "\r\n");
+    QHTTPENGINE_STATUS_CODES(QHTTPENGINE_STATUS_LINE)
+#undef QHTTPENGINE_STATUS_LINE
+    default: return QByteArray();
+    }
+}
+
+const ErrorPages *SocketPrivate::errorPages() const
+{
+    return connection ? connection->errorPages() : ErrorPages::defaultPages();
+}
 
+void SocketPrivate::read(QByteArray &buffer)
+{
     // If reading headers, return if they could not be read (yet)
-    if (readState == ReadHeaders && !readHeaders()) {
+    if (readState == ReadHeaders && !readHeaders(buffer)) {
         return;
     }
 
-    // Read data if in that state, otherwise discard
-    switch (readState) {
-    case ReadData:
-        readData();
-        break;
-    case ReadFinished:
-        readBuffer.clear();
-        break;
+    // Read data if in that state - anything left in the buffer belongs to
+    // the next request on the connection
+    if (readState == ReadData) {
+        readData(buffer);
     }
 }
 
 void SocketPrivate::onBytesWritten(qint64 bytes)
 {
+    // Let the handler know once enough data was sent for it to write more
+    writePending -= bytes;
+    if (writeBlocked && writePending <= writeLowWatermark) {
+        writeBlocked = false;
+        Q_EMIT q->writeBufferDrained();
+    }
+
+    // The interim response is not part of the response itself
+    if (continueRemaining) {
+        qint64 count = qMin(bytes, continueRemaining);
+        continueRemaining -= count;
+        bytes -= count;
+    }
+
     // Check to see if all of the response header was written
     if (writeState == WriteHeaders) {
         if (responseHeaderRemaining - bytes > 0) {
@@ -131,55 +235,205 @@ void SocketPrivate::onBytesWritten(qint64 bytes)
         }
     }
 
+    if (writeState != WriteData) {
+        return;
+    }
+
     // Only emit bytesWritten() for data after the headers
-    if (writeState == WriteData) {
+    if (!responseChunked) {
         Q_EMIT q->bytesWritten(bytes);
+        return;
     }
-}
 
-void SocketPrivate::onReadChannelFinished()
-{
-    if (requestDataTotal == -1) {
-        emit q->readChannelFinished();
+    // Leave out the chunk framing when counting the bytes of the body
+    qint64 body = 0;
+    while (bytes > 0 && responseBlocks.count()) {
+        qint64 count = qMin(bytes, responseBlocks.first().first);
+        if (responseBlocks.first().second) {
+            body += count;
+        }
+
+        bytes -= count;
+        responseBlocks.first().first -= count;
+        if (!responseBlocks.first().first) {
+            responseBlocks.removeFirst();
+        }
+    }
+
+    if (body) {
+        Q_EMIT q->bytesWritten(body);
     }
 }
 
-bool SocketPrivate::readHeaders()
+bool SocketPrivate::readHeaders(QByteArray &buffer)
 {
-    // Check for the double CRLF that signals the end of the headers and
-    // if it is not found, wait until the next time readyRead is emitted
-    int index = readBuffer.indexOf("\r\n\r\n");
+    // Check for the double CRLF that signals the end of the headers - only
+    // the data received since the last check needs to be searched. The last
+    // three bytes are left for the next check since they may begin the
+    // double CRLF, which also keeps the line break of a header that was just
+    // completed from being counted before it is known not to end the block
+    int index = buffer.indexOf("\r\n\r\n", headerScanned);
+    int end = index == -1 ? qMax(headerScanned, buffer.size() - 3) : index;
+    headerLines += std::count(buffer.constData() + headerScanned, buffer.constData() + end, '\n');
+    headerScanned = end;
+
+    // Reject the request as soon as the headers exceed the limits - if the
+    // request line is not even complete, the URI is too long
+    int maxSize = connection ? connection->maxHeaderSize() : DefaultMaxHeaderSize;
+    int maxCount = connection ? connection->maxHeaderCount() : DefaultMaxHeaderCount;
+    if (maxSize > 0 && (index == -1 ? buffer.size() : index + 4) > maxSize) {
+        q->writeError(headerLines ? Socket::RequestHeaderFieldsTooLarge : Socket::UriTooLong);
+        return false;
+    }
+    if (maxCount > 0 && headerLines > maxCount) {
+        q->writeError(Socket::RequestHeaderFieldsTooLarge);
+        return false;
+    }
+
+    // If the end of the headers was not found, wait until the next time
+    // readyRead is emitted
     if (index == -1) {
         return false;
     }
 
     // Attempt to parse the headers and if a problem is encountered, abort
-    // the connection (so that no more data is read or written) and return
-    if (!Parser::parseRequestHeaders(readBuffer.left(index), requestMethod, requestRawPath, requestHeaders) ||
-            !Parser::parsePath(requestRawPath, requestPath, requestQueryString)) {
+    // the connection (so that no more data is read or written) and return -
+    // the path and query string are only decoded once they are used
+    if (!Parser::parseRequestHeaders(buffer.left(index), requestMethod, requestRawPath, requestVersion, requestHeaders)) {
         q->writeError(Socket::BadRequest);
         return false;
     }
 
     // Remove the headers from the buffer
-    readBuffer.remove(0, index + 4);
+    removeFront(buffer, index + 4);
     readState = ReadData;
 
-    // If the content-length header is present, use it to determine
-    // how much data to expect from the socket - not all requests
-    // use this header - WebSocket requests, for example, do not
-    if (requestHeaders.contains("Content-Length")) {
-        requestDataTotal = requestHeaders.value("Content-Length").toLongLong();
+    // Persistent connections are the default for HTTP/1.1 but must be
+    // explicitly requested by HTTP/1.0 clients - the connection itself may
+    // also have reached its limit
+    IByteArray connectionHeader = requestHeaders.value(HeaderList::Connection);
+    if (requestVersion == "HTTP/1.1") {
+        keepAlive = !connectionHeader.contains("close");
+    } else {
+        keepAlive = connectionHeader.contains("keep-alive");
+    }
+    keepAlive = keepAlive && connection && connection->isKeepAliveAllowed();
+
+    // A body sent with chunked transfer encoding carries its own framing
+    // and the Content-Length header (if any) must be ignored - otherwise, if
+    // the content-length header is present, use it to determine how much
+    // data to expect from the socket - not all requests use this header -
+    // WebSocket requests, for example, do not
+    int statusCode = parseTransferEncoding(requestHeaders, requestChunked);
+    if (statusCode) {
+        abortRead(statusCode);
+        return false;
+    }
+    if (requestChunked) {
+
+        // A request with both may be an attempt to smuggle another request
+        // past an intermediary that framed the body differently, so nothing
+        // after it is trusted
+        if (requestHeaders.contains(HeaderList::ContentLength)) {
+            keepAlive = false;
+        }
+    } else if (!parseContentLength(requestHeaders, requestDataTotal)) {
+        abortRead(Socket::BadRequest);
+        return false;
+    }
+
+    // A request with neither a Content-Length header nor chunked encoding
+    // has no body (RFC 7230, section 3.3.3) - whether or not the connection
+    // is kept alive, anything after the headers is the next request
+    bool finished = !requestChunked && requestDataTotal <= 0;
+    if (finished) {
+        readState = ReadFinished;
+    }
+
+    // HTTP/1.1 clients may wait for permission before sending the body -
+    // "100-continue" is the only expectation defined and it is ignored for
+    // HTTP/1.0 clients
+    QByteArray expect = requestHeaders.value(HeaderList::Expect);
+    if (!expect.isNull() && requestVersion == "HTTP/1.1") {
+        if (IByteArray(expect.trimmed()) != "100-continue") {
+            q->writeError(Socket::ExpectationFailed);
+            return false;
+        }
+        continueExpected = !finished;
     }
 
     // Indicate that the headers have been parsed
     Q_EMIT q->headersParsed();
 
+    // The handler may have raised or lowered the limit while routing the
+    // request - reject a body that is known to be too large before it is sent
+    if (readState == ReadData && isBodyTooLarge()) {
+        abortRead(Socket::PayloadTooLarge);
+        return false;
+    }
+
+    // Unless a response was already written (rejecting the request without
+    // its body ever being sent), the client may now send the body
+    if (continueExpected && writeState == WriteNone) {
+        writeContinue();
+    }
+
+    if (finished) {
+        Q_EMIT q->readChannelFinished();
+    }
+
     return true;
 }
 
-void SocketPrivate::readData()
+void SocketPrivate::readData(QByteArray &buffer)
 {
+    // Chunks are decoded as they arrive so that the body can be read before
+    // all of it was received
+    if (requestChunked) {
+        bool finished = readChunks(buffer);
+        if (readState != ReadData) {
+            return;
+        }
+        if (isBodyTooLarge()) {
+            abortRead(Socket::PayloadTooLarge);
+            return;
+        }
+
+        if (readBuffer.size()) {
+            Q_EMIT q->readyRead();
+        }
+
+        if (finished) {
+            readState = ReadFinished;
+            Q_EMIT q->readChannelFinished();
+        }
+        return;
+    }
+
+    // Move the request body from the connection's buffer - if the length of
+    // the body is known, any data after it belongs to the next request
+    qint64 size = buffer.size();
+    if (requestDataTotal != -1) {
+        size = qMin(size, requestDataTotal - requestDataRead - readBuffer.size());
+    }
+
+    // If all of the buffer belongs to the body, its data can be shared
+    if (size > 0) {
+        if (size == buffer.size()) {
+            readBuffer.append(buffer);
+        } else {
+            readBuffer.append(buffer.constData(), size);
+        }
+        removeFront(buffer, size);
+    }
+
+    // Without a known length, the size of the body is only known as it
+    // arrives
+    if (isBodyTooLarge()) {
+        abortRead(Socket::PayloadTooLarge);
+        return;
+    }
+
     // Emit the readyRead() signal if any data is available in the buffer
     if (readBuffer.size()) {
         Q_EMIT q->readyRead();
@@ -187,16 +441,263 @@ void SocketPrivate::readData()
 
     // Check to see if the specified amount of data has been read from the
     // socket, if so, emit the readChannelFinished() signal
-    if (requestDataTotal != -1 &&
+    if (readState == ReadData && requestDataTotal != -1 &&
             requestDataRead + readBuffer.size() >= requestDataTotal) {
         readState = ReadFinished;
         Q_EMIT q->readChannelFinished();
     }
 }
 
-Socket::Socket(QTcpSocket *socket, QObject *parent)
+bool SocketPrivate::readChunks(QByteArray &buffer)
+{
+    // Keep track of the position in the buffer and remove everything that
+    // was decoded at once rather than after each line and chunk
+    int pos = 0;
+    bool finished = decodeChunks(buffer, pos);
+    removeFront(buffer, pos);
+    return finished;
+}
+
+bool SocketPrivate::decodeChunks(const QByteArray &buffer, int &pos)
+{
+    while (true) {
+        switch (chunkState) {
+        case ChunkSize:
+        case ChunkTrailer:
+        {
+            // Both the chunk size and the trailers are sent one line at a time
+            int index = buffer.indexOf("\r\n", pos);
+            if (index == -1) {
+                if (buffer.size() - pos > MaxChunkLineLength) {
+                    abortRead();
+                }
+                return false;
+            }
+            QByteArray line = buffer.mid(pos, index - pos);
+            pos = index + 2;
+
+            // The body ends with an empty line after the trailers, which are
+            // not used
+            if (chunkState == ChunkTrailer) {
+                if (line.isEmpty()) {
+                    return true;
+                }
+                break;
+            }
+
+            // The size is in hex and may be followed by extensions
+            int extIndex = line.indexOf(';');
+            if (extIndex != -1) {
+                line.truncate(extIndex);
+            }
+            bool ok;
+            chunkRemaining = line.trimmed().toLongLong(&ok, 16);
+            if (!ok || chunkRemaining < 0) {
+                abortRead();
+                return false;
+            }
+
+            // The last chunk is empty
+            chunkState = chunkRemaining ? ChunkData : ChunkTrailer;
+            break;
+        }
+        case ChunkData:
+        {
+            qint64 size = qMin(static_cast<qint64>(buffer.size() - pos), chunkRemaining);
+            if (!pos && size == buffer.size()) {
+                readBuffer.append(buffer);
+            } else {
+                readBuffer.append(buffer.constData() + pos, size);
+            }
+            pos += size;
+
+            chunkRemaining -= size;
+            if (chunkRemaining) {
+                return false;
+            }
+
+            chunkState = ChunkDataEnd;
+            break;
+        }
+        case ChunkDataEnd:
+        {
+            // The data in each chunk is followed by a CRLF
+            if (buffer.size() - pos < 2) {
+                return false;
+            }
+            if (buffer.at(pos) != '\r' || buffer.at(pos + 1) != '\n') {
+                abortRead();
+                return false;
+            }
+            pos += 2;
+
+            chunkState = ChunkSize;
+            break;
+        }
+        }
+    }
+}
+
+void SocketPrivate::abortRead(int statusCode)
+{
+    // The rest of the data on the connection cannot be interpreted, so it
+    // must not be reused
+    keepAlive = false;
+
+    if (writeState == WriteNone) {
+        q->writeError(statusCode);
+    } else {
+        q->close();
+    }
+}
+
+void SocketPrivate::abortBody()
+{
+    // The body could not be read back from the temporary file - the request
+    // is aborted once the handler is done reading rather than while it is
+    QTimer::singleShot(0, this, [this]() {
+        if (q->isOpen() && writeState != WriteFinished) {
+            abortRead(Socket::InternalServerError);
+        }
+    });
+}
+
+bool SocketPrivate::isBodyTooLarge() const
+{
+    return maxBodySize > 0 && (requestDataTotal > maxBodySize ||
+            requestDataRead + readBuffer.size() > maxBodySize);
+}
+
+void SocketPrivate::addResponseBlock(qint64 size, bool body)
+{
+    if (responseBlocks.count() && responseBlocks.last().second == body) {
+        responseBlocks.last().first += size;
+    } else {
+        responseBlocks.append(qMakePair(size, body));
+    }
+}
+
+void SocketPrivate::writeContinue()
+{
+    QByteArray data = statusLine(Socket::Continue) + "\r\n";
+
+    continueExpected = false;
+    continueRemaining += data.size();
+    write(data.constData(), data.size());
+}
+
+void SocketPrivate::writeChunk(const QByteArray &chunk)
+{
+    // Each chunk is preceded by its size in hex and followed by a CRLF -
+    // the last chunk is empty and marks the end of the body
+    QByteArray prefix = QByteArray::number(chunk.size(), 16) + "\r\n";
+    QByteArray data = prefix + chunk + "\r\n";
+
+    addResponseBlock(prefix.size(), false);
+    addResponseBlock(chunk.size(), true);
+    addResponseBlock(2, false);
+
+    if (chunk.isEmpty()) {
+        data.append("\r\n");
+        addResponseBlock(2, false);
+    }
+
+    write(data.constData(), data.size());
+}
+
+void SocketPrivate::writeErrorPage(const ErrorPages::Page &page)
+{
+    // The length of the body is known, so only the request decides whether
+    // the connection can be reused - see Socket::writeHeaders()
+    if (keepAlive && readState != ReadFinished) {
+        keepAlive = false;
+    }
+
+    ErrorPages::Variant variant = ErrorPages::Plain;
+    if (keepAlive && requestVersion == "HTTP/1.0") {
+        variant = ErrorPages::KeepAlive;
+    } else if (!keepAlive && requestVersion == "HTTP/1.1") {
+        variant = ErrorPages::Close;
+    }
+
+    writeState = WriteHeaders;
+    responseHeaderRemaining = page.headerSizes[variant];
+
+    // Only the headers are sent in response to a HEAD request
+    if (connection) {
+        const QByteArray &response = page.responses[variant];
+        write(response.constData(), requestMethod == Socket::HEAD ?
+                page.headerSizes[variant] : response.size());
+    }
+}
+
+void SocketPrivate::flushHeaders()
+{
+    if (responseHeaderBuffer.size() && connection) {
+        QByteArray header = responseHeaderBuffer;
+        responseHeaderBuffer.clear();
+        write(header.constData(), header.size());
+    }
+}
+
+qint64 SocketPrivate::write(const char *data, qint64 len)
+{
+    // Send headers that are still waiting along with the data if it is small
+    // enough so that the start of the response leaves in a single segment
+    if (responseHeaderBuffer.size()) {
+        if (len > MaxCoalescedSize) {
+            flushHeaders();
+        } else {
+            QByteArray combined = responseHeaderBuffer;
+            combined.append(data, len);
+            responseHeaderBuffer.clear();
+            qint64 written = write(combined.constData(), combined.size());
+            return written == -1 ? -1 : len;
+        }
+    }
+
+    qint64 written = connection->write(q, data, len);
+    if (written > 0) {
+        writePending += written;
+        if (writeHighWatermark > 0 && writePending >= writeHighWatermark) {
+            writeBlocked = true;
+        }
+    }
+    return written;
+}
+
+void SocketPrivate::flushWriteBuffer()
+{
+    if (writeBuffer.isEmpty() || !connection) {
+        return;
+    }
+
+    QByteArray data = writeBuffer;
+    writeBuffer.clear();
+
+    // The data was counted as pending when it was written - whatever the
+    // connection did not accept will never be reported as written
+    qint64 written = connection->write(q, data.constData(), data.size());
+    if (written < data.size()) {
+        writePending -= data.size() - qMax<qint64>(written, 0);
+    }
+}
+
+Socket::Socket(QIODevice *socket, QObject *parent)
+    : QIODevice(parent),
+      d(new SocketPrivate(this, new Connection(socket, this)))
+{
+    // The device is initially open for both reading and writing
+    setOpenMode(QIODevice::ReadWrite);
+
+    // The connection is used for this socket alone - process anything that
+    // was already received by the device
+    d->connection->start(this);
+}
+
+Socket::Socket(Connection *connection, QObject *parent)
     : QIODevice(parent),
-      d(new SocketPrivate(this, socket))
+      d(new SocketPrivate(this, connection))
 {
     // The device is initially open for both reading and writing
     setOpenMode(QIODevice::ReadWrite);
@@ -211,26 +712,103 @@ qint64 Socket::bytesAvailable() const
     }
 }
 
+QByteArray Socket::peekSegment()
+{
+    // Data already moved to the buffer of the QIODevice comes first
+    qint64 buffered = QIODevice::bytesAvailable();
+    if (buffered > 0) {
+        return QIODevice::peek(buffered);
+    }
+
+    if (d->readState == SocketPrivate::ReadHeaders) {
+        return QByteArray();
+    }
+
+    QByteArray data = d->readBuffer.peek();
+    if (d->readBuffer.hasReadError()) {
+        d->abortBody();
+    }
+    return data;
+}
+
+QByteArray Socket::readSegment()
+{
+    QByteArray data = peekSegment();
+    consume(data.size());
+    return data;
+}
+
+qint64 Socket::consume(qint64 len)
+{
+    qint64 size = 0;
+
+    qint64 buffered = QIODevice::bytesAvailable();
+    if (buffered > 0) {
+        size = QIODevice::read(qMin(len, buffered)).size();
+    }
+
+    if (size < len && d->readState != SocketPrivate::ReadHeaders) {
+        qint64 skipped = d->readBuffer.skip(len - size);
+        d->requestDataRead += skipped;
+        size += skipped;
+    }
+
+    return size;
+}
+
 bool Socket::isSequential() const
 {
     return true;
 }
 
+qint64 Socket::bytesToWrite() const
+{
+    return d->responseHeaderBuffer.size() + d->writePending;
+}
+
+void Socket::setWriteWatermarks(qint64 high, qint64 low)
+{
+    d->writeHighWatermark = high;
+    d->writeLowWatermark = low;
+}
+
+bool Socket::canWrite() const
+{
+    return !d->writeBlocked;
+}
+
 void Socket::close()
 {
     // Invoke the parent method
     QIODevice::close();
 
+    // The connection cannot be reused if no response was written
+    if (d->writeState == SocketPrivate::WriteNone) {
+        d->keepAlive = false;
+    }
+
+    // Write the last chunk to mark the end of a chunked response and any
+    // headers still waiting to be written
+    if (d->responseChunked && d->writeState != SocketPrivate::WriteFinished && d->connection) {
+        d->writeChunk(QByteArray());
+    }
+    d->flushHeaders();
+
     d->readState = SocketPrivate::ReadFinished;
     d->writeState = SocketPrivate::WriteFinished;
 
-    connect(d->socket, &QTcpSocket::disconnected, this, &Socket::deleteLater);
-    d->socket->close();
+    // The connection will either prepare for the next request or close
+    if (d->connection) {
+        d->connection->finish(this);
+    } else {
+        deleteLater();
+    }
 }
 
 QHostAddress Socket::peerAddress() const
 {
-    return d->socket->peerAddress();
+    return d->connection && d->connection->tcpSocket ?
+                d->connection->tcpSocket->peerAddress() : QHostAddress();
 }
 
 bool Socket::isHeadersParsed() const
@@ -238,6 +816,11 @@ bool Socket::isHeadersParsed() const
     return d->readState > SocketPrivate::ReadHeaders;
 }
 
+bool Socket::isReadFinished() const
+{
+    return d->readState == SocketPrivate::ReadFinished;
+}
+
 Socket::Method Socket::method() const
 {
     return d->requestMethod;
@@ -250,19 +833,56 @@ QByteArray Socket::rawPath() const
 
 QString Socket::path() const
 {
+    if (!d->requestPathValid) {
+        d->requestPath = Parser::decodePath(d->requestRawPath);
+        d->requestPathValid = true;
+    }
     return d->requestPath;
 }
 
 Socket::QueryStringMap Socket::queryString() const
 {
+    if (!d->requestQueryStringValid) {
+        Parser::parseQueryString(d->requestRawPath, d->requestQueryString);
+        d->requestQueryStringValid = true;
+    }
     return d->requestQueryString;
 }
 
 Socket::HeaderMap Socket::headers() const
+{
+    if (!d->requestHeaderMapValid) {
+        d->requestHeaderMap = d->requestHeaders.toMap();
+        d->requestHeaderMapValid = true;
+    }
+    return d->requestHeaderMap;
+}
+
+const HeaderList &Socket::headerList() const
 {
     return d->requestHeaders;
 }
 
+QByteArray Socket::header(HeaderList::Id id) const
+{
+    return d->requestHeaders.value(id);
+}
+
+QByteArray Socket::header(const QByteArray &name) const
+{
+    return d->requestHeaders.value(name);
+}
+
+void Socket::setMaxBodySize(qint64 bytes)
+{
+    d->maxBodySize = bytes;
+
+    // The body that is still being received may already exceed the limit
+    if (d->readState == SocketPrivate::ReadData && d->isBodyTooLarge()) {
+        d->abortRead(PayloadTooLarge);
+    }
+}
+
 qint64 Socket::contentLength() const
 {
     return d->requestDataTotal;
@@ -270,8 +890,14 @@ qint64 Socket::contentLength() const
 
 bool Socket::readJson(QJsonDocument &document)
 {
+    // A body that arrived in a single piece is parsed without copying it
+    QByteArray data = readSegment();
+    for (QByteArray segment = readSegment(); segment.size(); segment = readSegment()) {
+        data.append(segment);
+    }
+
     QJsonParseError error;
-    document = QJsonDocument::fromJson(readAll(), &error);
+    document = QJsonDocument::fromJson(data, &error);
 
     if (error.error != QJsonParseError::NoError) {
         writeError(Socket::BadRequest);
@@ -303,14 +929,50 @@ void Socket::setHeaders(const HeaderMap &headers)
 
 void Socket::writeHeaders()
 {
+    // The connection can only be reused if the request body was received in
+    // full and the handler did not ask for it to be closed
+    if (d->keepAlive && (d->readState != SocketPrivate::ReadFinished ||
+            IByteArray(d->responseHeaders.value("Connection")).contains("close"))) {
+        d->keepAlive = false;
+    }
+
+    // The client must also be able to determine where the response ends -
+    // if the length of the body is unknown, HTTP/1.1 clients receive it in
+    // chunks, otherwise the end is signalled by closing the connection
+    bool noBody = (d->responseStatusCode >= 100 && d->responseStatusCode < 200) ||
+            d->responseStatusCode == NoContent || d->responseStatusCode == NotModified ||
+            d->requestMethod == HEAD;
+    if (d->keepAlive && !noBody && !d->responseHeaders.contains("Content-Length")) {
+        if (d->requestVersion == "HTTP/1.1" &&
+                !d->responseHeaders.contains("Transfer-Encoding")) {
+            setHeader("Transfer-Encoding", "chunked");
+            d->responseChunked = true;
+        } else {
+            d->keepAlive = false;
+        }
+    }
+
+    // Let the client know if the connection will behave differently than
+    // the default for the version of HTTP it used
+    if (d->keepAlive && d->requestVersion == "HTTP/1.0") {
+        setHeader("Connection", "keep-alive");
+    } else if (!d->keepAlive && d->requestVersion == "HTTP/1.1") {
+        setHeader("Connection", "close");
+    }
+
     // Use a QByteArray for building the header so that we can later determine
     // exactly how many bytes were written
     QByteArray header;
 
-    // Append the status line
-    header.append("HTTP/1.0 ");
-    header.append(QByteArray::number(d->responseStatusCode) + " " + d->responseStatusReason);
-    header.append("\r\n");
+    // Append the status line - the one for a predefined reason is a constant
+    QByteArray statusLine = d->statusLine(d->responseStatusCode);
+    if (!statusLine.isNull() && d->responseStatusReason == d->statusReason(d->responseStatusCode)) {
+        header.append(statusLine);
+    } else {
+        header.append("HTTP/1.1 ");
+        header.append(QByteArray::number(d->responseStatusCode) + " " + d->responseStatusReason);
+        header.append("\r\n");
+    }
 
     // Append each of the headers followed by a CRLF
     for (auto i = d->responseHeaders.constBegin(); i != d->responseHeaders.constEnd(); ++i) {
@@ -326,8 +988,11 @@ void Socket::writeHeaders()
     d->writeState = SocketPrivate::WriteHeaders;
     d->responseHeaderRemaining = header.length();
 
-    // Write the header
-    d->socket->write(header);
+    // Hold on to the header so that it can be combined with the body if the
+    // handler writes it right away - otherwise it is sent once control
+    // returns to the event loop
+    d->responseHeaderBuffer = header;
+    QTimer::singleShot(0, d, &SocketPrivate::flushHeaders);
 }
 
 void Socket::writeRedirect(const QByteArray &path, bool permanent)
@@ -342,12 +1007,20 @@ void Socket::writeError(int statusCode, const QByteArray &statusReason)
 {
     setStatusCode(statusCode, statusReason);
 
+    // Unless the handler added headers or a reason of its own, the entire
+    // response was rendered in advance
+    if (statusReason.isNull() && d->responseHeaders.isEmpty() &&
+            d->writeState == SocketPrivate::WriteNone) {
+        const ErrorPages::Page *page = d->errorPages()->page(statusCode);
+        if (page) {
+            d->writeErrorPage(*page);
+            close();
+            return;
+        }
+    }
+
     // Build the template that will be sent to the client
-    QByteArray data = ErrorTemplate
-            .arg(d->responseStatusCode)
-            .arg(d->responseStatusReason.constData())
-            .arg(QHTTPENGINE_VERSION)
-            .toUtf8();
+    QByteArray data = d->errorPages()->render(d->responseStatusCode, d->responseStatusReason);
 
     setHeader("Content-Length", QByteArray::number(data.length()));
     setHeader("Content-Type", "text/html");
@@ -374,12 +1047,13 @@ qint64 Socket::readData(char *data, qint64 maxlen)
         return 0;
     }
 
-    // Ensure that no more than the requested amount or the size of the buffer is read
-    qint64 size = qMin(static_cast<qint64>(d->readBuffer.size()), maxlen);
-    memcpy(data, d->readBuffer.constData(), size);
-
-    // Remove the amount that was read from the buffer
-    d->readBuffer.remove(0, size);
+    // Ensure that no more than the requested amount or the size of the
+    // buffer is read - the buffer removes it without moving the rest
+    qint64 size = d->readBuffer.read(data, maxlen);
+    if (size == -1) {
+        d->abortBody();
+        return -1;
+    }
     d->requestDataRead += size;
 
     return size;
@@ -393,5 +1067,23 @@ qint64 Socket::writeData(const char *data, qint64 len)
         writeHeaders();
     }
 
-    return d->socket->write(data, len);
+    if (!d->connection) {
+        return -1;
+    }
+
+    // The response to a HEAD request has no body - the headers describe the
+    // body that would have been sent, so the data is accepted and dropped
+    if (d->requestMethod == HEAD) {
+        return len;
+    }
+
+    // An empty chunk would end the response, so there is nothing to write
+    if (d->responseChunked) {
+        if (len) {
+            d->writeChunk(QByteArray::fromRawData(data, len));
+        }
+        return len;
+    }
+
+    return d->write(data, len);
 }
@@ -23,25 +23,71 @@
 #ifndef QHTTPENGINE_SOCKET_P_H
 #define QHTTPENGINE_SOCKET_P_H
 
+#include <QPointer>
+
 #include <qhttpengine/socket.h>
 
-class QTcpSocket;
+#include "bodybuffer.h"
+#include "errorpages.h"
+
+// Status codes with a predefined reason - each entry lists the name of the
+// constant in Socket, its value and the reason
+#define QHTTPENGINE_STATUS_CODES(X) \
+    X(Continue, 100, "CONTINUE") \
+    X(OK, 200, "OK") \
+    X(Created, 201, "CREATED") \
+    X(Accepted, 202, "ACCEPTED") \
+    X(NoContent, 204, "NO CONTENT") \
+    X(PartialContent, 206, "PARTIAL CONTENT") \
+    X(MovedPermanently, 301, "MOVED PERMANENTLY") \
+    X(Found, 302, "FOUND") \
+    X(NotModified, 304, "NOT MODIFIED") \
+    X(BadRequest, 400, "BAD REQUEST") \
+    X(Unauthorized, 401, "UNAUTHORIZED") \
+    X(Forbidden, 403, "FORBIDDEN") \
+    X(NotFound, 404, "NOT FOUND") \
+    X(MethodNotAllowed, 405, "METHOD NOT ALLOWED") \
+    X(Conflict, 409, "CONFLICT") \
+    X(PayloadTooLarge, 413, "PAYLOAD TOO LARGE") \
+    X(UriTooLong, 414, "URI TOO LONG") \
+    X(ExpectationFailed, 417, "EXPECTATION FAILED") \
+    X(RequestHeaderFieldsTooLarge, 431, "REQUEST HEADER FIELDS TOO LARGE") \
+    X(InternalServerError, 500, "INTERNAL SERVER ERROR") \
+    X(NotImplemented, 501, "NOT IMPLEMENTED") \
+    X(BadGateway, 502, "BAD GATEWAY") \
+    X(ServiceUnavailable, 503, "SERVICE UNAVAILABLE") \
+    X(HttpVersionNotSupported, 505, "HTTP VERSION NOT SUPPORTED")
 
 namespace QHttpEngine
 {
 
+class Connection;
+
 class SocketPrivate : public QObject
 {
     Q_OBJECT
 
 public:
 
-    SocketPrivate(Socket *httpSocket, QTcpSocket *tcpSocket);
+    SocketPrivate(Socket *httpSocket, Connection *httpConnection);
+
+    static QByteArray statusReason(int statusCode);
+    static QByteArray statusLine(int statusCode);
 
-    QByteArray statusReason(int statusCode) const;
+    const ErrorPages *errorPages() const;
+
+    void read(QByteArray &buffer);
+    void onBytesWritten(qint64 bytes);
+    void writeChunk(const QByteArray &chunk);
+    void writeErrorPage(const ErrorPages::Page &page);
+    qint64 write(const char *data, qint64 len);
+    void flushWriteBuffer();
+    void abortRead(int statusCode = Socket::BadRequest);
+    void abortBody();
+    bool isBodyTooLarge() const;
 
-    QTcpSocket *socket;
-    QByteArray readBuffer;
+    QPointer<Connection> connection;
+    BodyBuffer readBuffer;
 
     enum {
         ReadHeaders,
@@ -51,12 +97,49 @@ public:
 
     Socket::Method requestMethod;
     QByteArray requestRawPath;
+    QByteArray requestVersion;
+
+    // Decoded path and query string, created when first requested
     QString requestPath;
+    bool requestPathValid;
     Socket::QueryStringMap requestQueryString;
-    Socket::HeaderMap requestHeaders;
+    bool requestQueryStringValid;
+
+    HeaderList requestHeaders;
+
+    // Map of the request headers, created when first requested
+    Socket::HeaderMap requestHeaderMap;
+    bool requestHeaderMapValid;
     qint64 requestDataRead;
     qint64 requestDataTotal;
 
+    // Largest request body accepted (or 0 for no limit)
+    qint64 maxBodySize;
+
+    // Amount of the buffer already searched for the end of the headers and
+    // the number of line breaks found in it
+    int headerScanned;
+    int headerLines;
+
+    // State of the decoder for a request body that uses chunked transfer
+    // encoding and the amount of data left in the current chunk
+    bool requestChunked;
+    enum {
+        ChunkSize,
+        ChunkData,
+        ChunkDataEnd,
+        ChunkTrailer
+    } chunkState;
+    qint64 chunkRemaining;
+
+    bool keepAlive;
+
+    // Whether the client is waiting for an interim response before sending
+    // the body and the number of bytes of the interim response that were not
+    // written yet
+    bool continueExpected;
+    qint64 continueRemaining;
+
     enum {
         WriteNone,
         WriteHeaders,
@@ -64,21 +147,44 @@ public:
         WriteFinished
     } writeState;
 
+    // Response headers that were not written yet so that they can be sent
+    // together with the start of the body
+    QByteArray responseHeaderBuffer;
+
     int responseStatusCode;
     QByteArray responseStatusReason;
     Socket::HeaderMap responseHeaders;
     qint64 responseHeaderRemaining;
 
-private Q_SLOTS:
+    // Bytes written to the connection that the client has not received yet
+    // and the limits used to throttle writing
+    qint64 writePending;
+    qint64 writeHighWatermark;
+    qint64 writeLowWatermark;
+    bool writeBlocked;
 
-    void onReadyRead();
-    void onBytesWritten(qint64 bytes);
-    void onReadChannelFinished();
+    // Whether the body is sent using chunked transfer encoding and the sizes
+    // of the blocks written for it - only blocks with body data (rather than
+    // chunk framing) count toward bytesWritten()
+    bool responseChunked;
+    QList<QPair<qint64, bool> > responseBlocks;
+
+    // Data written while responses to earlier requests are pending
+    QByteArray writeBuffer;
+
+public Q_SLOTS:
+
+    void flushHeaders();
 
 private:
 
-    bool readHeaders();
-    void readData();
+    bool readHeaders(QByteArray &buffer);
+    void readData(QByteArray &buffer);
+    bool readChunks(QByteArray &buffer);
+    bool decodeChunks(const QByteArray &buffer, int &pos);
+
+    void addResponseBlock(qint64 size, bool body);
+    void writeContinue();
 
     Socket*const q;
 };
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "timerwheel.h"
+
+using namespace QHttpEngine;
+
+// Length of a single tick in milliseconds
+const int TickInterval = 50;
+
+WheelTimer::WheelTimer(const std::function<void()> &callback)
+    : callback(callback),
+      wheel(0),
+      prev(0),
+      next(0),
+      expiry(0)
+{
+}
+
+WheelTimer::~WheelTimer()
+{
+    stop();
+}
+
+void WheelTimer::start(TimerWheel *wheel, int msec)
+{
+    if (!wheel || msec <= 0) {
+        stop();
+        return;
+    }
+    if (this->wheel && this->wheel != wheel) {
+        stop();
+    }
+    wheel->start(this, msec);
+}
+
+void WheelTimer::stop()
+{
+    if (wheel) {
+        wheel->stop(this);
+    }
+}
+
+bool WheelTimer::isActive() const
+{
+    return wheel;
+}
+
+TimerWheel::TimerWheel(QObject *parent)
+    : QObject(parent),
+      timer(this),
+      current(0),
+      active(0)
+{
+    for (int level = 0; level < LevelCount; ++level) {
+        for (int slot = 0; slot < SlotCount; ++slot) {
+            buckets[level][slot] = 0;
+        }
+    }
+
+    elapsed.start();
+
+    timer.setInterval(TickInterval);
+    connect(&timer, &QTimer::timeout, this, &TimerWheel::onTimeout);
+}
+
+TimerWheel::~TimerWheel()
+{
+    // Timers that outlive the wheel must not try to remove themselves later
+    for (int level = 0; level < LevelCount; ++level) {
+        for (int slot = 0; slot < SlotCount; ++slot) {
+            for (WheelTimer *timer = buckets[level][slot]; timer; timer = timer->next) {
+                timer->wheel = 0;
+                timer->prev = 0;
+            }
+        }
+    }
+}
+
+int TimerWheel::count() const
+{
+    return active;
+}
+
+void TimerWheel::onTimeout()
+{
+    // Catch up on any ticks missed while the event loop was busy
+    quint64 target = now();
+    while (active && current < target) {
+        advance();
+    }
+
+    if (!active) {
+        timer.stop();
+    }
+}
+
+void TimerWheel::start(WheelTimer *timer, int msec)
+{
+    if (timer->wheel) {
+        remove(timer);
+    } else {
+
+        // The wheel does not advance while it is empty
+        if (!active) {
+            current = now();
+        }
+        ++active;
+    }
+
+    // The current tick has already partly elapsed, so an extra one is added
+    const quint64 maxTicks = (Q_UINT64_C(1) << (SlotBits * LevelCount)) - 1;
+    quint64 ticks = (msec + TickInterval - 1) / TickInterval + 1;
+    ticks = qMin(ticks, maxTicks);
+
+    timer->wheel = this;
+    timer->expiry = qMin(now() + ticks, current + maxTicks);
+    insert(timer);
+
+    if (!this->timer.isActive()) {
+        this->timer.start();
+    }
+}
+
+void TimerWheel::stop(WheelTimer *timer)
+{
+    remove(timer);
+    timer->wheel = 0;
+    --active;
+}
+
+void TimerWheel::insert(WheelTimer *timer)
+{
+    // Use the lowest level with a range that includes the expiry - the slot
+    // is then emptied on the tick that the timer expires or, for the upper
+    // levels, on the tick that begins the range of the slot
+    quint64 delta = timer->expiry - current;
+    int level = 0;
+    while (level < LevelCount - 1 && delta >= (Q_UINT64_C(1) << (SlotBits * (level + 1)))) {
+        ++level;
+    }
+    int slot = (timer->expiry >> (SlotBits * level)) & (SlotCount - 1);
+
+    WheelTimer **head = &buckets[level][slot];
+    timer->prev = head;
+    timer->next = *head;
+    if (*head) {
+        (*head)->prev = &timer->next;
+    }
+    *head = timer;
+}
+
+void TimerWheel::remove(WheelTimer *timer)
+{
+    *timer->prev = timer->next;
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = 0;
+    timer->next = 0;
+}
+
+void TimerWheel::cascade(int level)
+{
+    int slot = (current >> (SlotBits * level)) & (SlotCount - 1);
+
+    WheelTimer *timer = buckets[level][slot];
+    buckets[level][slot] = 0;
+
+    while (timer) {
+        WheelTimer *next = timer->next;
+        insert(timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::advance()
+{
+    ++current;
+
+    // Each time a level wraps around, the next slot of the level above it is
+    // moved down
+    for (int level = 1; level < LevelCount; ++level) {
+        if (current & ((Q_UINT64_C(1) << (SlotBits * level)) - 1)) {
+            break;
+        }
+        cascade(level);
+    }
+
+    // The callback may start or stop other timers (including ones in this
+    // slot), so remove them one at a time
+    WheelTimer **head = &buckets[0][current & (SlotCount - 1)];
+    while (*head) {
+        WheelTimer *timer = *head;
+        stop(timer);
+        timer->callback();
+    }
+}
+
+quint64 TimerWheel::now() const
+{
+    return elapsed.elapsed() / TickInterval;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_TIMERWHEEL_H
+#define QHTTPENGINE_TIMERWHEEL_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+namespace QHttpEngine
+{
+
+class TimerWheel;
+
+/**
+ * @brief Timeout scheduled on a TimerWheel
+ *
+ * The callback is invoked once the timeout expires unless the timer is
+ * stopped or restarted before then. A timer is stopped when it is destroyed,
+ * so it can safely be a member of the object it refers to.
+ */
+class WheelTimer
+{
+public:
+
+    explicit WheelTimer(const std::function<void()> &callback);
+    ~WheelTimer();
+
+    void start(TimerWheel *wheel, int msec);
+    void stop();
+
+    bool isActive() const;
+
+private:
+
+    std::function<void()> callback;
+
+    TimerWheel *wheel;
+    WheelTimer **prev;
+    WheelTimer *next;
+    quint64 expiry;
+
+    friend class TimerWheel;
+};
+
+/**
+ * @brief Hierarchical timer wheel shared by many timeouts
+ *
+ * Rather than each connection using its own QTimer, timeouts are stored in
+ * slots according to the tick at which they expire and a single QTimer
+ * advances the wheel while any timeout is pending. Each level of the wheel
+ * covers a range of ticks 64 times larger than the one below it - timeouts
+ * in the upper levels are moved down as their expiry approaches. Starting,
+ * stopping and expiring a timeout therefore take constant time no matter
+ * how many are pending.
+ *
+ * Timeouts are rounded up to whole ticks, so they expire no earlier than
+ * requested and at most two ticks later.
+ */
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit TimerWheel(QObject *parent = 0);
+    ~TimerWheel();
+
+    int count() const;
+
+private Q_SLOTS:
+
+    void onTimeout();
+
+private:
+
+    enum {
+        SlotBits = 6,
+        SlotCount = 1 << SlotBits,
+        LevelCount = 4
+    };
+
+    void start(WheelTimer *timer, int msec);
+    void stop(WheelTimer *timer);
+
+    void insert(WheelTimer *timer);
+    void remove(WheelTimer *timer);
+    void cascade(int level);
+    void advance();
+
+    quint64 now() const;
+
+    QElapsedTimer elapsed;
+
+    // The timer is a child of the wheel so that it moves to another thread
+    // along with it
+    QTimer timer;
+
+    // Each slot is the head of a doubly linked list of timers
+    WheelTimer *buckets[LevelCount][SlotCount];
+    quint64 current;
+    int active;
+
+    friend class WheelTimer;
+};
+
+}
+
+#endif // QHTTPENGINE_TIMERWHEEL_H
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QTimer>
+
+#if !defined(QT_NO_SSL)
+#  include <QSslSocket>
+#endif
+
+#include <qhttpengine/handler.h>
+#include <qhttpengine/socket.h>
+
+#include "connection.h"
+#include "counters.h"
+#include "handover.h"
+#include "listener.h"
+#include "server_p.h"
+#include "worker.h"
+
+using namespace QHttpEngine;
+
+// Time that a rejected socket is kept open after its response was written,
+// so that the client can receive it before the connection is closed
+const int RejectLingerTime = 1000;
+
+// Largest number of rejected sockets that a worker keeps open at once
+const int MaxPendingRejects = 64;
+
+Worker::Worker(ServerPrivate *server, QObject *parent)
+    : QObject(parent),
+      server(server),
+      timerWheel(this),
+      listener(0),
+      poolSize(server->connectionPoolSize),
+      pendingRejects(0)
+{
+}
+
+bool Worker::listen(qintptr socketDescriptor)
+{
+    closeListener();
+    listener = new Listener(server, this);
+    return listener->setSocketDescriptor(socketDescriptor);
+}
+
+void Worker::closeListener()
+{
+    // Connections that were waiting for a free slot have not sent anything
+    // yet, so they are simply closed along with the listener
+    delete listener;
+    listener = 0;
+}
+
+void Worker::accept(qintptr socketDescriptor, Transport transport)
+{
+    server->counters->connectionCount.ref();
+
+    if (transport == LocalTransport) {
+        QLocalSocket *socket = new QLocalSocket(this);
+        socket->setSocketDescriptor(socketDescriptor);
+        process(socket);
+        return;
+    }
+
+#if !defined(QT_NO_SSL)
+    if (!server->configuration.isNull()) {
+
+        // Initialize the socket with the SSL configuration
+        QSslSocket *socket = new QSslSocket(this);
+        handshakes.insert(socket);
+
+        // Wait until encryption is complete before processing the socket
+        connect(socket, &QSslSocket::encrypted, [this, socket]() {
+            handshakes.remove(socket);
+            process(socket);
+        });
+
+        // If an error occurs during the handshake, delete the socket - once
+        // the connection owns it, errors are its concern
+        connect(socket, static_cast<void(QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+                this, [this, socket]() {
+            dropHandshake(socket);
+        });
+
+        socket->setSocketDescriptor(socketDescriptor);
+        socket->setSslConfiguration(server->configuration);
+        socket->startServerEncryption();
+
+    } else {
+#endif
+
+        // Process the socket immediately
+        process(socketDescriptor);
+
+#if !defined(QT_NO_SSL)
+    }
+#endif
+}
+
+void Worker::reject(qintptr socketDescriptor, Transport transport)
+{
+    rejectedCount.ref();
+
+    // Rejected sockets use up descriptors as well, so once too many of them
+    // are waiting to be closed, the rest are closed without a response
+    if (pendingRejects >= MaxPendingRejects) {
+        ServerPrivate::close(socketDescriptor, transport);
+        return;
+    }
+
+    QIODevice *socket;
+    if (transport == LocalTransport) {
+        QLocalSocket *localSocket = new QLocalSocket(this);
+        localSocket->setSocketDescriptor(socketDescriptor);
+        connect(localSocket, &QLocalSocket::disconnected, localSocket, &QLocalSocket::deleteLater);
+        socket = localSocket;
+    } else {
+        QTcpSocket *tcpSocket = new QTcpSocket(this);
+        tcpSocket->setSocketDescriptor(socketDescriptor);
+        connect(tcpSocket, &QTcpSocket::disconnected, tcpSocket, &QTcpSocket::deleteLater);
+
+        // There is no time to negotiate encryption, so the client is simply
+        // disconnected
+#if !defined(QT_NO_SSL)
+        if (!server->configuration.isNull()) {
+            tcpSocket->abort();
+            return;
+        }
+#endif
+
+        socket = tcpSocket;
+    }
+
+    ++pendingRejects;
+    connect(socket, &QObject::destroyed, this, [this]() {
+        --pendingRejects;
+    });
+
+    // The response is sent right away without waiting for the request -
+    // anything the client sends is discarded and the socket is kept open
+    // for a moment so that closing it does not reset the connection before
+    // the client received the response
+    const ErrorPages *pages = server->errorPages ? server->errorPages.data() : ErrorPages::defaultPages();
+    socket->write(pages->page(Socket::ServiceUnavailable)->responses[ErrorPages::Close]);
+    connect(socket, &QIODevice::readyRead, socket, [socket]() {
+        socket->readAll();
+    });
+    QTimer::singleShot(RejectLingerTime, socket, [socket]() {
+        socket->close();
+    });
+}
+
+void Worker::process(QIODevice *socket)
+{
+    Connection *connection = new Connection(socket, this);
+
+    // A socket is created for each request received on the connection
+    connect(connection, &Connection::newSocket, this, &Worker::onNewSocket);
+
+    // Once the client disconnects, the connection and any remaining sockets
+    // are no longer needed - unless the connection can be reused, in which
+    // case it is kept until all of the sockets are destroyed
+    connect(connection, &Connection::disconnected, this, [this, connection]() {
+        connections.remove(connection);
+        finish();
+        if (!isPoolable(connection)) {
+            disconnect(connection, &Connection::released, this, 0);
+            connection->deleteLater();
+        }
+    });
+    connect(connection, &Connection::released, this, [this, connection]() {
+        release(connection);
+    });
+
+    start(connection);
+}
+
+void Worker::handOver(const QSharedPointer<Handover> &handover)
+{
+    foreach (Connection *connection, connections) {
+
+        // The state of an encrypted connection cannot be passed on and a
+        // local socket has no place in the new process
+        if (connection->isIdle() && isPlainTcp(connection) &&
+                handover->send(Handover::ClientSocket, connection->tcpSocket->socketDescriptor())) {
+
+            // The other process holds the socket open, so the client does not
+            // notice that this end is closed
+            connection->abort();
+        }
+    }
+}
+
+void Worker::drain()
+{
+    closeListener();
+
+    // Encrypted connections that are still being negotiated have not sent a
+    // request yet
+    foreach (QTcpSocket *socket, handshakes) {
+        dropHandshake(socket);
+    }
+
+    // Closing a connection may remove it from the set right away
+    foreach (Connection *connection, connections) {
+        connection->drain();
+    }
+}
+
+void Worker::abort()
+{
+    foreach (QTcpSocket *socket, handshakes) {
+        dropHandshake(socket);
+    }
+
+    foreach (Connection *connection, connections) {
+        connection->abort();
+    }
+}
+
+void Worker::setPoolSize(int size)
+{
+    poolSize = size;
+    while (connectionPool.count() > poolSize) {
+        delete connectionPool.takeLast();
+    }
+}
+
+void Worker::process(qintptr socketDescriptor)
+{
+    // Reuse a connection (and its QTcpSocket) if one is available
+    if (connectionPool.count()) {
+        Connection *connection = connectionPool.takeLast();
+        connection->tcpSocket->setSocketDescriptor(socketDescriptor);
+        start(connection);
+        return;
+    }
+
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    process(socket);
+}
+
+void Worker::start(Connection *connection)
+{
+    server->configure(connection);
+    connection->setTimerWheel(&timerWheel);
+
+    connections.insert(connection);
+    connection->start();
+}
+
+void Worker::release(Connection *connection)
+{
+    if (isPoolable(connection)) {
+        connection->reset();
+        connectionPool.append(connection);
+    } else {
+        connection->deleteLater();
+    }
+}
+
+void Worker::dropHandshake(QTcpSocket *socket)
+{
+    if (handshakes.remove(socket)) {
+        socket->abort();
+        socket->deleteLater();
+        finish();
+    }
+}
+
+void Worker::finish()
+{
+    connectionCount.deref();
+    server->counters->connectionCount.deref();
+    Q_EMIT connectionClosed();
+}
+
+bool Worker::isPoolable(Connection *connection) const
+{
+    // Encrypted connections and local sockets cannot be reused
+    return connectionPool.count() < poolSize && isPlainTcp(connection);
+}
+
+bool Worker::isPlainTcp(Connection *connection) const
+{
+    return connection->socket->metaObject() == &QTcpSocket::staticMetaObject;
+}
+
+void Worker::onNewSocket(Socket *httpSocket)
+{
+    server->counters->requestCount.ref();
+
+    // Wait until the socket finishes reading the HTTP headers before routing
+    connect(httpSocket, &Socket::headersParsed, [this, httpSocket]() {
+        if (server->handler) {
+            server->handler->route(httpSocket, QString(httpSocket->path().mid(1)));
+        } else {
+            httpSocket->writeError(Socket::InternalServerError);
+        }
+    });
+}
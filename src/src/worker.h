@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef QHTTPENGINE_WORKER_H
+#define QHTTPENGINE_WORKER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+
+#include "timerwheel.h"
+
+class QIODevice;
+class QTcpSocket;
+
+namespace QHttpEngine
+{
+
+class Connection;
+class Handover;
+class Listener;
+class ServerPrivate;
+class Socket;
+
+/**
+ * @brief Event loop that serves connections for a server
+ *
+ * Each worker owns the connections it accepts along with everything created
+ * for them - the QTcpSocket, the [Socket](@ref QHttpEngine::Socket) for each
+ * request and the timer wheel used for their timeouts. A server serves its
+ * connections with a single worker on its own thread unless it was asked to
+ * use worker threads, in which case each worker is moved to a thread of its
+ * own and every method other than the constructor must be invoked on that
+ * thread.
+ *
+ * A worker may also accept connections itself from a Listener of its own.
+ *
+ * Connections may arrive over TCP or through a local socket. Only TCP
+ * connections are encrypted, reused or handed over to another process.
+ *
+ * The number of connections assigned to the worker is increased by the
+ * server (or the listener) when it hands a connection over and decreased by the worker once
+ * the client disconnects, so that the server can balance the load and
+ * enforce its limits without waiting for the worker.
+ */
+class Worker : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // Kind of socket that a descriptor handed to the worker refers to
+    enum Transport {
+        TcpTransport,
+        LocalTransport
+    };
+
+    explicit Worker(ServerPrivate *server, QObject *parent = 0);
+
+    bool listen(qintptr socketDescriptor);
+    void closeListener();
+    void accept(qintptr socketDescriptor, Transport transport = TcpTransport);
+    void reject(qintptr socketDescriptor, Transport transport = TcpTransport);
+    void process(QIODevice *socket);
+    void handOver(const QSharedPointer<Handover> &handover);
+    void drain();
+    void abort();
+    void setPoolSize(int size);
+
+    // Connections assigned to the worker that have not closed yet and the
+    // number of connections it turned away
+    QAtomicInt connectionCount;
+    QAtomicInt rejectedCount;
+
+Q_SIGNALS:
+
+    void connectionClosed();
+
+private Q_SLOTS:
+
+    void onNewSocket(Socket *httpSocket);
+
+private:
+
+    void process(qintptr socketDescriptor);
+    void start(Connection *connection);
+    void release(Connection *connection);
+    void dropHandshake(QTcpSocket *socket);
+    void finish();
+    bool isPoolable(Connection *connection) const;
+    bool isPlainTcp(Connection *connection) const;
+
+    ServerPrivate *const server;
+
+    // Timeouts for all of the connections are scheduled on a single wheel
+    TimerWheel timerWheel;
+
+    // Socket that the worker accepts connections from itself (if any)
+    Listener *listener;
+
+    // Number of connections kept for reuse - a copy of the setting of the
+    // server, since it may change while the worker is running
+    int poolSize;
+
+    // Number of rejected sockets that are still open
+    int pendingRejects;
+
+    // Connections that can be reused for new clients
+    QList<Connection*> connectionPool;
+
+    // Connections with a client that has not disconnected yet and encrypted
+    // connections that are still being negotiated
+    QSet<Connection*> connections;
+    QSet<QTcpSocket*> handshakes;
+};
+
+}
+
+#endif // QHTTPENGINE_WORKER_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QHash>
+#include <QObject>
+#include <QTest>
+
+#include <qhttpengine/ibytearray.h>
+
+class BenchmarkIByteArray : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void benchmarkCompare_data();
+    void benchmarkCompare();
+
+    void benchmarkHash_data();
+    void benchmarkHash();
+};
+
+void BenchmarkIByteArray::benchmarkCompare_data()
+{
+    QTest::addColumn<bool>("lower");
+    QTest::addColumn<QByteArray>("a1");
+    QTest::addColumn<QByteArray>("a2");
+
+    QByteArray shortKey1("Content-Length");
+    QByteArray shortKey2("content-length");
+    QByteArray longKey1 = QByteArray("X-Forwarded-For-").repeated(16);
+    QByteArray longKey2 = longKey1.toUpper();
+
+    // The "toLower" rows measure the comparison that was used previously
+    QTest::newRow("short toLower") << true << shortKey1 << shortKey2;
+    QTest::newRow("short") << false << shortKey1 << shortKey2;
+    QTest::newRow("long toLower") << true << longKey1 << longKey2;
+    QTest::newRow("long") << false << longKey1 << longKey2;
+}
+
+void BenchmarkIByteArray::benchmarkCompare()
+{
+    QFETCH(bool, lower);
+    QFETCH(QByteArray, a1);
+    QFETCH(QByteArray, a2);
+
+    QHttpEngine::IByteArray i1(a1);
+    bool equal = true;
+
+    if (lower) {
+        QBENCHMARK {
+            equal &= a1.toLower() == a2.toLower();
+        }
+    } else {
+        QBENCHMARK {
+            equal &= i1 == a2;
+        }
+    }
+
+    QVERIFY(equal);
+}
+
+void BenchmarkIByteArray::benchmarkHash_data()
+{
+    QTest::addColumn<QByteArray>("key");
+
+    QTest::newRow("short") << QByteArray("Content-Length");
+    QTest::newRow("long") << QByteArray("X-Forwarded-For-").repeated(16);
+}
+
+void BenchmarkIByteArray::benchmarkHash()
+{
+    QFETCH(QByteArray, key);
+
+    QHttpEngine::IByteArray i(key);
+    uint hash = 0;
+
+    QBENCHMARK {
+        hash ^= qHash(i);
+    }
+
+    Q_UNUSED(hash);
+}
+
+QTEST_MAIN(BenchmarkIByteArray)
+#include "BenchmarkIByteArray.moc"
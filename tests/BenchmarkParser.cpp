@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QObject>
+#include <QPair>
+#include <QTest>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <qhttpengine/headerlist.h>
+#include <qhttpengine/parser.h>
+#include <qhttpengine/socket.h>
+
+// Headers of a typical request from a browser
+const QByteArray Request =
+        "GET /api/items/caf%C3%A9?page=2&sort=name&filter=a%20b HTTP/1.1\r\n"
+        "Host: localhost:8000\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:60.0) Gecko/20100101 Firefox/60.0\r\n"
+        "Accept: application/json, text/plain, */*\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Connection: keep-alive";
+
+class BenchmarkParser : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void benchmarkRequest_data();
+    void benchmarkRequest();
+};
+
+void BenchmarkParser::benchmarkRequest_data()
+{
+    QTest::addColumn<QString>("mode");
+
+    // The "QUrl" row measures the parsing that was used previously, "path"
+    // measures a handler that only routes by path
+    QTest::newRow("QUrl") << QString("QUrl");
+    QTest::newRow("path and query") << QString("query");
+    QTest::newRow("path") << QString("path");
+}
+
+void BenchmarkParser::benchmarkRequest()
+{
+    QFETCH(QString, mode);
+
+    QBENCHMARK {
+        QHttpEngine::Socket::Method method;
+        QByteArray rawPath;
+        QByteArray version;
+        QHttpEngine::HeaderList headers;
+        QVERIFY(QHttpEngine::Parser::parseRequestHeaders(Request, method, rawPath, version, headers));
+
+        QString path;
+        QHttpEngine::Socket::QueryStringMap queryString;
+        if (mode == "QUrl") {
+            QUrl url(rawPath);
+            path = url.path();
+            QPair<QString, QString> pair;
+            foreach (pair, QUrlQuery(url.query()).queryItems()) {
+                queryString.insert(pair.first, pair.second);
+            }
+        } else if (mode == "query") {
+            QHttpEngine::Parser::parsePath(rawPath, path, queryString);
+        } else {
+            path = QHttpEngine::Parser::decodePath(rawPath);
+        }
+        QVERIFY(!path.isEmpty());
+    }
+}
+
+QTEST_MAIN(BenchmarkParser)
+#include "BenchmarkParser.moc"
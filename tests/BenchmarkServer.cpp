@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QEventLoop>
+#include <QObject>
+#include <QTcpSocket>
+#include <QTest>
+#include <QThread>
+
+#include <qhttpengine/qobjecthandler.h>
+#include <qhttpengine/server.h>
+#include <qhttpengine/socket.h>
+
+// Number of connections made for each measurement - dividing it by the
+// time taken gives the number of new connections per second
+const int ConnectionCount = 1000;
+
+// Number of threads making connections at the same time when comparing
+// ways of listening
+const int ClientThreadCount = 4;
+
+const QByteArray Request = "GET /test HTTP/1.1\r\nConnection: close\r\n\r\n";
+const QByteArray Data = "test";
+
+// Thread that makes one connection after another, each sending a single
+// request and waiting for the server to close it
+class ClientThread : public QThread
+{
+public:
+
+    ClientThread(quint16 port, int count) : port(port), count(count) {}
+
+protected:
+
+    void run() {
+        for (int i = 0; i < count; ++i) {
+            QTcpSocket socket;
+            socket.connectToHost(QHostAddress::LocalHost, port);
+            if (socket.waitForConnected()) {
+                socket.write(Request);
+                socket.waitForDisconnected();
+            }
+        }
+    }
+
+private:
+
+    quint16 port;
+    int count;
+};
+
+class BenchmarkServer : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void benchmarkConnections_data();
+    void benchmarkConnections();
+    void benchmarkListeners_data();
+    void benchmarkListeners();
+};
+
+void BenchmarkServer::benchmarkConnections_data()
+{
+    QTest::addColumn<int>("poolSize");
+
+    QTest::newRow("no pool") << 0;
+    QTest::newRow("pool") << 64;
+}
+
+void BenchmarkServer::benchmarkConnections()
+{
+    QFETCH(int, poolSize);
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setConnectionPoolSize(poolSize);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QBENCHMARK {
+        for (int i = 0; i < ConnectionCount; ++i) {
+            QTcpSocket socket;
+            QEventLoop loop;
+            connect(&socket, &QTcpSocket::connected, [&]() {
+                socket.write(Request);
+            });
+            connect(&socket, &QTcpSocket::disconnected, &loop, &QEventLoop::quit);
+
+            // Each client sends a single request and waits for the server to
+            // close the connection
+            socket.connectToHost(server.serverAddress(), server.serverPort());
+            loop.exec();
+        }
+    }
+}
+
+void BenchmarkServer::benchmarkListeners_data()
+{
+    QTest::addColumn<bool>("reusePort");
+
+    QTest::newRow("single listener") << false;
+    QTest::newRow("reuse port") << true;
+}
+
+void BenchmarkServer::benchmarkListeners()
+{
+    QFETCH(bool, reusePort);
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setWorkerThreadCount(QThread::idealThreadCount());
+    if (reusePort) {
+        if (!server.listenReusePort(QHostAddress::LocalHost)) {
+            QSKIP("SO_REUSEPORT is not supported");
+        }
+    } else {
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+    }
+
+    QBENCHMARK {
+
+        // The clients run on their own threads so that the thread of the
+        // server is free to accept connections
+        QList<ClientThread*> threads;
+        for (int i = 0; i < ClientThreadCount; ++i) {
+            threads.append(new ClientThread(server.serverPort(), ConnectionCount / ClientThreadCount));
+        }
+
+        QEventLoop loop;
+        int running = threads.count();
+        foreach (ClientThread *thread, threads) {
+            connect(thread, &QThread::finished, &loop, [&]() {
+                if (!--running) {
+                    loop.quit();
+                }
+            });
+            thread->start();
+        }
+        loop.exec();
+
+        qDeleteAll(threads);
+    }
+}
+
+QTEST_MAIN(BenchmarkServer)
+#include "BenchmarkServer.moc"
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QEventLoop>
+#include <QObject>
+#include <QTest>
+
+#include <qhttpengine/socket.h>
+
+#include "common/qsocketpair.h"
+
+// Size of the blocks written by the client and of the pieces read by the
+// server
+const qint64 WriteSize = 65536;
+const qint64 ReadSize = 4096;
+
+class BenchmarkSocket : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void benchmarkRead_data();
+    void benchmarkRead();
+};
+
+void BenchmarkSocket::benchmarkRead_data()
+{
+    QTest::addColumn<qint64>("size");
+
+    QTest::newRow("1 MB") << Q_INT64_C(1048576);
+    QTest::newRow("64 MB") << Q_INT64_C(67108864);
+    QTest::newRow("1 GB") << Q_INT64_C(1073741824);
+}
+
+void BenchmarkSocket::benchmarkRead()
+{
+    QFETCH(qint64, size);
+
+    QSocketPair pair;
+    QTRY_VERIFY(pair.isConnected());
+    QHttpEngine::Socket *server = new QHttpEngine::Socket(pair.server(), &pair);
+
+    QByteArray block(WriteSize, 'a');
+    qint64 written = 0;
+    qint64 read = 0;
+
+    // Only keep a few blocks waiting to be written by the client at a time
+    auto write = [&]() {
+        while (written < size && pair.client()->bytesToWrite() < 4 * WriteSize) {
+            qint64 count = qMin(size - written, WriteSize);
+            pair.client()->write(block.constData(), count);
+            written += count;
+        }
+    };
+    connect(pair.client(), &QTcpSocket::bytesWritten, write);
+
+    // Read the body in small pieces as it arrives
+    char data[ReadSize];
+    connect(server, &QHttpEngine::Socket::readyRead, [&]() {
+        while (server->bytesAvailable()) {
+            read += server->read(data, ReadSize);
+        }
+    });
+
+    QEventLoop loop;
+    connect(server, &QHttpEngine::Socket::readChannelFinished, &loop, &QEventLoop::quit);
+
+    QBENCHMARK_ONCE {
+        pair.client()->write("POST /test HTTP/1.1\r\nContent-Length: " + QByteArray::number(size) + "\r\n\r\n");
+        write();
+        loop.exec();
+    }
+
+    QCOMPARE(read, size);
+}
+
+QTEST_MAIN(BenchmarkSocket)
+#include "BenchmarkSocket.moc"
@@ -49,6 +49,8 @@ private Q_SLOTS:
     void testRequests_data();
     void testRequests();
 
+    void testHead();
+
 private:
 
     bool createFile(const QString &path);
@@ -193,6 +195,30 @@ void TestFilesystemHandler::testRangeRequests()
     }
 }
 
+void TestFilesystemHandler::testHead()
+{
+    QHttpEngine::FilesystemHandler handler(QDir(dir.path()).absoluteFilePath("root"));
+
+    QSocketPair pair;
+    QTRY_VERIFY(pair.isConnected());
+
+    QSignalSpy disconnectedSpy(pair.client(), SIGNAL(disconnected()));
+
+    QSimpleHttpClient client(pair.client());
+    QHttpEngine::Socket *socket = new QHttpEngine::Socket(pair.server(), &pair);
+
+    client.sendHeaders("HEAD", "inside");
+    QTRY_VERIFY(socket->isHeadersParsed());
+
+    handler.route(socket, "inside");
+
+    // The headers describe the file but none of it is sent
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(client.statusCode(), static_cast<int>(QHttpEngine::Socket::OK));
+    QCOMPARE(client.headers().value("Content-Length").toInt(), Data.length());
+    QCOMPARE(client.data(), QByteArray());
+}
+
 bool TestFilesystemHandler::createFile(const QString &path)
 {
     QFile file(QDir(dir.path()).absoluteFilePath(path));
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017 Aleksei Ermakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QObject>
+#include <QTest>
+
+#include <qhttpengine/headerlist.h>
+#include <qhttpengine/parser.h>
+
+const QByteArray Data =
+        "GET / HTTP/1.1\r\n"
+        "content-length: 13\r\n"
+        "X-Custom:  value \r\n"
+        "Empty:\r\n"
+        "Content-Length: 14";
+
+class TestHeaderList : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testId();
+    void testValue();
+    void testList();
+};
+
+void TestHeaderList::testId()
+{
+    QCOMPARE(QHttpEngine::HeaderList::id("content-LENGTH"), QHttpEngine::HeaderList::ContentLength);
+    QCOMPARE(QHttpEngine::HeaderList::id("X-Custom"), QHttpEngine::HeaderList::Unknown);
+    QCOMPARE(QHttpEngine::HeaderList::id("X-Forwarded-Fox"), QHttpEngine::HeaderList::Unknown);
+    QCOMPARE(QHttpEngine::HeaderList::name(QHttpEngine::HeaderList::Range), QByteArray("Range"));
+
+    for (int i = 0; i < QHttpEngine::HeaderList::IdCount; ++i) {
+        QHttpEngine::HeaderList::Id id = static_cast<QHttpEngine::HeaderList::Id>(i);
+        QByteArray name = QHttpEngine::HeaderList::name(id);
+        QCOMPARE(QHttpEngine::HeaderList::id(name), id);
+        QCOMPARE(QHttpEngine::HeaderList::id(name.toLower()), id);
+        QCOMPARE(QHttpEngine::HeaderList::id(name.toUpper()), id);
+    }
+}
+
+void TestHeaderList::testValue()
+{
+    QHttpEngine::Socket::Method method;
+    QByteArray path;
+    QByteArray version;
+    QHttpEngine::HeaderList headers;
+    QVERIFY(QHttpEngine::Parser::parseRequestHeaders(Data, method, path, version, headers));
+
+    // The last value is used for a header that appears more than once
+    QVERIFY(headers.contains(QHttpEngine::HeaderList::ContentLength));
+    QCOMPARE(headers.value(QHttpEngine::HeaderList::ContentLength), QByteArray("14"));
+    QCOMPARE(headers.value("CONTENT-LENGTH"), QByteArray("14"));
+    QCOMPARE(headers.value("x-custom"), QByteArray("value"));
+
+    // Empty headers are present, missing ones are null
+    QVERIFY(headers.contains("Empty"));
+    QVERIFY(!headers.value("Empty").isNull());
+    QVERIFY(!headers.contains(QHttpEngine::HeaderList::Host));
+    QVERIFY(headers.value(QHttpEngine::HeaderList::Host).isNull());
+}
+
+void TestHeaderList::testList()
+{
+    QHttpEngine::HeaderList headers;
+    headers.insert("Host", "example.com");
+    headers.insert("X-Custom", "value");
+
+    QHttpEngine::HeaderList copy(headers);
+    headers.clear();
+    QCOMPARE(headers.count(), 0);
+
+    QCOMPARE(copy.count(), 2);
+    QCOMPARE(copy.nameAt(1), QByteArray("X-Custom"));
+    QCOMPARE(copy.valueAt(1), QByteArray("value"));
+    QCOMPARE(copy.idAt(0), QHttpEngine::HeaderList::Host);
+
+    QHttpEngine::Socket::HeaderMap map = copy.toMap();
+    QCOMPARE(map.value("host"), QByteArray("example.com"));
+    QCOMPARE(map.value("x-custom"), QByteArray("value"));
+}
+
+QTEST_MAIN(TestHeaderList)
+#include "TestHeaderList.moc"
@@ -54,6 +54,11 @@ private Q_SLOTS:
     TEST_TYPE(QString, QString)
 
     void testContains();
+    void testCompare_data();
+    void testCompare();
+    void testCompareString_data();
+    void testCompareString();
+    void testHash();
 };
 
 void TestIByteArray::testContains()
@@ -65,5 +70,61 @@ void TestIByteArray::testContains()
     QVERIFY(v.contains(QByteArray(Value2)));
 }
 
+void TestIByteArray::testCompare_data()
+{
+    QTest::addColumn<QByteArray>("a1");
+    QTest::addColumn<QByteArray>("a2");
+    QTest::addColumn<int>("sign");
+
+    QTest::newRow("empty") << QByteArray() << QByteArray() << 0;
+    QTest::newRow("prefix") << QByteArray("content") << QByteArray("Content-Length") << -1;
+    QTest::newRow("long equal") << QByteArray("X-Forwarded-For-Proxy") << QByteArray("x-forwarded-for-PROXY") << 0;
+    QTest::newRow("long differ") << QByteArray("x-forwarded-for-a") << QByteArray("X-FORWARDED-FOR-B") << -1;
+    QTest::newRow("boundaries") << QByteArray("@[`{@[`{") << QByteArray("@[`{@[`{") << 0;
+    QTest::newRow("not letters") << QByteArray("@@@@@@@@") << QByteArray("````````") << -1;
+    QTest::newRow("high bit") << QByteArray("\xc1\xc1\xc1\xc1\xc1\xc1\xc1\xc1") << QByteArray("\xe1\xe1\xe1\xe1\xe1\xe1\xe1\xe1") << -1;
+}
+
+void TestIByteArray::testCompare()
+{
+    QFETCH(QByteArray, a1);
+    QFETCH(QByteArray, a2);
+    QFETCH(int, sign);
+
+    int result = QHttpEngine::IByteArray::caseInsensitiveCompare(a1, a2);
+    QCOMPARE(result < 0 ? -1 : result > 0 ? 1 : 0, sign);
+    result = QHttpEngine::IByteArray::caseInsensitiveCompare(a2, a1);
+    QCOMPARE(result < 0 ? -1 : result > 0 ? 1 : 0, -sign);
+}
+
+void TestIByteArray::testCompareString_data()
+{
+    QTest::addColumn<QByteArray>("a1");
+    QTest::addColumn<QString>("a2");
+    QTest::addColumn<int>("sign");
+
+    QTest::newRow("empty") << QByteArray() << QString() << 0;
+    QTest::newRow("equal") << QByteArray("Content-Length") << QString("content-length") << 0;
+    QTest::newRow("prefix") << QByteArray("content") << QString("Content-Length") << -1;
+    QTest::newRow("differ") << QByteArray("x-a") << QString("X-B") << -1;
+    QTest::newRow("non-ascii") << QByteArray("x-\xc3\x84") << QString::fromUtf8("X-\xc3\xa4") << 0;
+}
+
+void TestIByteArray::testCompareString()
+{
+    QFETCH(QByteArray, a1);
+    QFETCH(QString, a2);
+    QFETCH(int, sign);
+
+    int result = QHttpEngine::IByteArray::caseInsensitiveCompare(a1, a2);
+    QCOMPARE(result < 0 ? -1 : result > 0 ? 1 : 0, sign);
+}
+
+void TestIByteArray::testHash()
+{
+    QCOMPARE(qHash(QHttpEngine::IByteArray("Content-Type")),
+             qHash(QHttpEngine::IByteArray("CONTENT-TYPE")));
+}
+
 QTEST_MAIN(TestIByteArray)
 #include "TestIByteArray.moc"
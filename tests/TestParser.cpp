@@ -147,6 +147,26 @@ void TestParser::testParsePath_data()
             << QByteArray("/path?a=b")
             << QString("/path")
             << QHttpEngine::Socket::QueryStringMap{{"a", "b"}};
+
+    QTest::newRow("multiple parameters")
+            << QByteArray("/path?a=b&&c&d=")
+            << QString("/path")
+            << QHttpEngine::Socket::QueryStringMap{{"a", "b"}, {"c", ""}, {"d", ""}};
+
+    QTest::newRow("percent encoding")
+            << QByteArray("/a%20b/%C3%A9%zz?k%3D=v%26w")
+            << QString::fromUtf8("/a b/\xc3\xa9%zz")
+            << QHttpEngine::Socket::QueryStringMap{{"k=", "v&w"}};
+
+    QTest::newRow("fragment")
+            << QByteArray("/path?a=b#c")
+            << QString("/path")
+            << QHttpEngine::Socket::QueryStringMap{{"a", "b"}};
+
+    QTest::newRow("absolute URI")
+            << QByteArray("http://example.com/path?a=b")
+            << QString("/path")
+            << QHttpEngine::Socket::QueryStringMap{{"a", "b"}};
 }
 
 void TestParser::testParsePath()
@@ -255,12 +275,23 @@ void TestParser::testParseRequestHeaders()
 
     QCOMPARE(QHttpEngine::Parser::parseRequestHeaders(data, outMethod, outPath, outHeaders), success);
 
+    // The flat list of headers must produce the same result
+    QHttpEngine::Socket::Method outListMethod;
+    QByteArray outListPath;
+    QByteArray outListVersion;
+    QHttpEngine::HeaderList outList;
+
+    QCOMPARE(QHttpEngine::Parser::parseRequestHeaders(data, outListMethod, outListPath, outListVersion, outList), success);
+
     if (success) {
         QFETCH(QHttpEngine::Socket::Method, method);
         QFETCH(QByteArray, path);
 
         QCOMPARE(method, outMethod);
         QCOMPARE(path, outPath);
+        QCOMPARE(method, outListMethod);
+        QCOMPARE(path, outListPath);
+        QCOMPARE(outList.toMap(), outHeaders);
     }
 }
 
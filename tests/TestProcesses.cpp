@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2017 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QSet>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QTest>
+
+#include <qhttpengine/qobjecthandler.h>
+#include <qhttpengine/server.h>
+#include <qhttpengine/socket.h>
+
+const QByteArray StatusLine = "HTTP/1.1 200 OK";
+
+/*
+ * Worker processes must be forked before any other threads are started, so
+ * they are tested on their own rather than after the tests of the server
+ */
+class TestProcesses : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testProcesses();
+};
+
+void TestProcesses::testProcesses()
+{
+#if !defined(Q_OS_UNIX)
+    QSKIP("Worker processes are only supported on Unix");
+#endif
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+        socket->setHeader("Content-Length", QByteArray::number(pid.length()));
+        socket->write(pid);
+        socket->close();
+    });
+    handler.registerMethod("crash", [](QHttpEngine::Socket *) {
+        std::_Exit(1);
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QVERIFY(server.forkProcesses(2));
+
+    // The worker processes serve connections until the supervisor drains
+    // them - they must not go on to run the rest of the tests
+    if (!server.isSupervisor()) {
+        QEventLoop loop;
+        connect(&server, &QHttpEngine::Server::drained, &loop, &QEventLoop::quit);
+        loop.exec();
+        std::_Exit(0);
+    }
+
+    auto fetch = [&](const QByteArray &path) {
+        QTcpSocket socket;
+        socket.connectToHost(server.serverAddress(), server.serverPort());
+        socket.write("GET /" + path + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+        QByteArray response;
+        while (socket.state() != QAbstractSocket::UnconnectedState && socket.waitForReadyRead()) {
+            response.append(socket.readAll());
+        }
+        return response;
+    };
+
+    // Every request is served by one of the worker processes
+    QSet<QByteArray> pids;
+    for (int i = 0; i < 8; ++i) {
+        QByteArray response = fetch("test");
+        QVERIFY(response.startsWith(StatusLine));
+        pids.insert(response.mid(response.indexOf("\r\n\r\n") + 4));
+    }
+    QVERIFY(!pids.contains(QByteArray::number(QCoreApplication::applicationPid())));
+
+    QList<QHttpEngine::Server::ProcessStatistics> statistics = server.processStatistics();
+    QCOMPARE(statistics.count(), 2);
+    qint64 requestCount = 0;
+    foreach (const QHttpEngine::Server::ProcessStatistics &process, statistics) {
+        requestCount += process.requestCount;
+        QVERIFY(process.bytesWritten > 0 || !process.requestCount);
+    }
+    QCOMPARE(requestCount, 8);
+
+    // A worker process that crashes is replaced and its counters carry over
+    QList<qint64> before;
+    foreach (const QHttpEngine::Server::ProcessStatistics &process, statistics) {
+        before.append(process.pid);
+    }
+    fetch("crash");
+
+    auto isReplaced = [&]() {
+        QList<QHttpEngine::Server::ProcessStatistics> statistics = server.processStatistics();
+        qint64 requestCount = 0;
+        foreach (const QHttpEngine::Server::ProcessStatistics &process, statistics) {
+            requestCount += process.requestCount;
+        }
+        return statistics.count() == 2 && requestCount == 9 &&
+                !(before.contains(statistics.at(0).pid) && before.contains(statistics.at(1).pid));
+    };
+    QTRY_VERIFY(isReplaced());
+    QVERIFY(fetch("test").startsWith(StatusLine));
+
+    // Draining the supervisor waits for the worker processes to exit
+    QSignalSpy drainedSpy(&server, SIGNAL(drained()));
+    server.drain();
+    QTRY_COMPARE(drainedSpy.count(), 1);
+    QCOMPARE(server.processStatistics().count(), 0);
+}
+
+QTEST_MAIN(TestProcesses)
+#include "TestProcesses.moc"
@@ -51,6 +51,7 @@ private Q_SLOTS:
     void testOldConnection_data();
     void testOldConnection();
     void testNewConnection();
+    void testChunkedBody();
 };
 
 void TestQObjectHandler::testOldConnection_data()
@@ -129,5 +130,37 @@ void TestQObjectHandler::testNewConnection()
     }
 }
 
+void TestQObjectHandler::testChunkedBody()
+{
+    QByteArray body;
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&body](QHttpEngine::Socket *socket) {
+        body = socket->readAll();
+        socket->writeError(QHttpEngine::Socket::OK);
+    });
+
+    QSocketPair pair;
+    QTRY_VERIFY(pair.isConnected());
+
+    QSimpleHttpClient client(pair.client());
+    QHttpEngine::Socket *socket = new QHttpEngine::Socket(pair.server(), &pair);
+
+    client.sendHeaders("POST", "test", QHttpEngine::Socket::HeaderMap{
+        {"Transfer-Encoding", "chunked"}
+    });
+    QTRY_VERIFY(socket->isHeadersParsed());
+
+    // The length of the body is unknown, so the slot must not be invoked
+    // until the last chunk has arrived
+    handler.route(socket, socket->path());
+    client.sendData("4\r\ntest\r\n");
+    QTRY_COMPARE(socket->bytesAvailable(), 4);
+    QCOMPARE(client.statusCode(), 0);
+
+    client.sendData("0\r\n\r\n");
+    QTRY_COMPARE(client.statusCode(), static_cast<int>(QHttpEngine::Socket::OK));
+    QCOMPARE(body, QByteArray("test"));
+}
+
 QTEST_MAIN(TestQObjectHandler)
 #include "TestQObjectHandler.moc"
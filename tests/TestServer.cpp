@@ -20,8 +20,29 @@
  * IN THE SOFTWARE.
  */
 
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QMutex>
+#include <QPointer>
+#include <QSet>
+#include <QSignalSpy>
 #include <QTcpSocket>
+#include <QTemporaryDir>
 #include <QTest>
+#include <QThread>
+#include <QTimer>
+
+#if defined(Q_OS_UNIX)
+#  include <signal.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
 
 #if !defined(QT_NO_SSL)
 #  include <QFile>
@@ -33,9 +54,14 @@
 
 #include <qhttpengine/server.h>
 #include <qhttpengine/handler.h>
+#include <qhttpengine/qobjecthandler.h>
 
 #include "common/qsimplehttpclient.h"
 
+const QByteArray Data = "test";
+const QByteArray Request = "GET /test HTTP/1.1\r\n\r\n";
+const QByteArray StatusLine = "HTTP/1.1 200 OK";
+
 class TestHandler : public QHttpEngine::Handler
 {
     Q_OBJECT
@@ -50,6 +76,14 @@ public:
     QString mPath;
 };
 
+// Determine whether nothing is listening on the port
+static bool isRefused(quint16 port)
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    return !socket.waitForConnected(1000);
+}
+
 class TestServer : public QObject
 {
     Q_OBJECT
@@ -57,6 +91,38 @@ class TestServer : public QObject
 private Q_SLOTS:
 
     void testServer();
+    void testKeepAlive();
+    void testMaxRequests();
+    void testLastRequestWithoutBody();
+    void testBodyFraming_data();
+    void testBodyFraming();
+    void testPipelining();
+    void testPipelinedBackpressure();
+    void testChunked();
+    void testHeaderLimits_data();
+    void testHeaderLimits();
+    void testSocketOptions();
+    void testTimeouts_data();
+    void testTimeouts();
+    void testWriteTimeout();
+    void testExpectContinue();
+    void testExpectContinueRejected();
+    void testMaxBodySize_data();
+    void testMaxBodySize();
+    void testBodyBuffer();
+    void testBodyBufferStreaming();
+    void testConnectionPool();
+    void testErrorTemplate();
+    void testWorkerThreads();
+    void testReusePort();
+    void testHandOver();
+    void testHandOverReusePort();
+    void testHandOverPathInUse();
+    void testLocal();
+    void testMaxConnections();
+    void testRejectConnections();
+    void testDrain();
+    void testDrainTimeout();
 
 #if !defined(QT_NO_SSL)
     void testSsl();
@@ -80,6 +146,1141 @@ void TestServer::testServer()
     QTRY_COMPARE(handler.mPath, QString("test"));
 }
 
+void TestServer::testKeepAlive()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // Each request should receive a response on the same connection
+    for (int i = 1; i <= 3; ++i) {
+        socket.write(Request);
+        QTRY_COMPARE(response.count(StatusLine), i);
+    }
+
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+}
+
+void TestServer::testMaxRequests()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setMaxRequestsPerConnection(2);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QSignalSpy disconnectedSpy(&socket, SIGNAL(disconnected()));
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write(Request);
+    QTRY_COMPARE(response.count(StatusLine), 1);
+    QVERIFY(!response.contains("Connection: close"));
+
+    // The second response must indicate that the connection is closing
+    socket.write(Request);
+    QTRY_COMPARE(response.count(StatusLine), 2);
+    QVERIFY(response.contains("Connection: close"));
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+}
+
+void TestServer::testLastRequestWithoutBody()
+{
+    // Anything following the headers of a request without a Content-Length
+    // header must not be read as its body, even on the last request
+    QByteArray body;
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&body](QHttpEngine::Socket *socket) {
+        body = socket->readAll();
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setMaxRequestsPerConnection(1);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QSignalSpy disconnectedSpy(&socket, SIGNAL(disconnected()));
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write(Request + Request);
+    QTRY_COMPARE(response.count(StatusLine), 1);
+    QVERIFY(response.contains("Connection: close"));
+    QVERIFY(body.isEmpty());
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+}
+
+void TestServer::testBodyFraming_data()
+{
+    QTest::addColumn<QByteArray>("headers");
+    QTest::addColumn<QByteArray>("statusLine");
+
+    QTest::newRow("letters") << QByteArray("Content-Length: abc\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("trailing garbage") << QByteArray("Content-Length: 5x\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("negative") << QByteArray("Content-Length: -5\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("overflow") << QByteArray("Content-Length: 99999999999999999999\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("conflicting list") << QByteArray("Content-Length: 0, 5\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("conflicting headers") << QByteArray("Content-Length: 0\r\nContent-Length: 5\r\n") << QByteArray("HTTP/1.1 400");
+
+    QTest::newRow("chunked not last") << QByteArray("Transfer-Encoding: chunked, gzip\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("chunked twice") << QByteArray("Transfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("no chunked") << QByteArray("Transfer-Encoding: gzip\r\n") << QByteArray("HTTP/1.1 400");
+    QTest::newRow("unknown coding") << QByteArray("Transfer-Encoding: chunkedx\r\n") << QByteArray("HTTP/1.1 501");
+
+    // The body is framed by the chunks but the connection is not reused
+    QTest::newRow("with chunked")
+            << QByteArray("Transfer-Encoding: chunked\r\nContent-Length: 3\r\n")
+            << StatusLine;
+}
+
+void TestServer::testBodyFraming()
+{
+    QFETCH(QByteArray, headers);
+    QFETCH(QByteArray, statusLine);
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // Whatever follows the headers must never be taken as another request
+    socket.write("POST /test HTTP/1.1\r\n" + headers + "\r\n0\r\n\r\n" + Request);
+    QTRY_VERIFY(response.startsWith(statusLine));
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+    QCOMPARE(response.count("HTTP/1.1"), 1);
+}
+
+void TestServer::testPipelining()
+{
+    auto respond = [](QHttpEngine::Socket *socket, const QByteArray &data) {
+        socket->setHeader("Content-Length", QByteArray::number(data.length()));
+        socket->write(data);
+        socket->close();
+    };
+
+    // The first request is answered after a delay, the second immediately
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("slow", [respond](QHttpEngine::Socket *socket) {
+        QTimer::singleShot(100, socket, [respond, socket]() {
+            respond(socket, "slow");
+        });
+    });
+    handler.registerMethod("fast", [respond](QHttpEngine::Socket *socket) {
+        respond(socket, "fast");
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // Send both requests at once - the responses must arrive in order
+    socket.write("GET /slow HTTP/1.1\r\n\r\nGET /fast HTTP/1.1\r\n\r\n");
+    QTRY_COMPARE(response.count(StatusLine), 2);
+
+    QVERIFY(response.indexOf("slow") < response.indexOf("fast"));
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+}
+
+void TestServer::testPipelinedBackpressure()
+{
+    // The first request is answered only once the second response was queued
+    QHttpEngine::Socket *slow = 0;
+    QHttpEngine::Socket *fast = 0;
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("slow", [&slow](QHttpEngine::Socket *socket) {
+        slow = socket;
+    });
+    handler.registerMethod("fast", [&fast](QHttpEngine::Socket *socket) {
+        fast = socket;
+        socket->setWriteWatermarks(Data.length(), 0);
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->writeHeaders();
+        socket->write(Data);
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write("GET /slow HTTP/1.1\r\n\r\nGET /fast HTTP/1.1\r\n\r\n");
+    QTRY_VERIFY(slow && fast);
+
+    // The queued response counts toward the watermarks of its socket
+    QSignalSpy writeBufferDrainedSpy(fast, SIGNAL(writeBufferDrained()));
+    QVERIFY(fast->bytesToWrite() >= Data.length());
+    QVERIFY(!fast->canWrite());
+
+    slow->setHeader("Content-Length", QByteArray::number(Data.length()));
+    slow->write(Data);
+    slow->close();
+
+    QTRY_COMPARE(writeBufferDrainedSpy.count(), 1);
+    QCOMPARE(fast->bytesToWrite(), 0);
+    QVERIFY(fast->canWrite());
+
+    fast->close();
+    QTRY_COMPARE(response.count(StatusLine), 2);
+}
+
+void TestServer::testChunked()
+{
+    // Write the body in two pieces without setting the length
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->write(Data);
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write(Request);
+    QTRY_VERIFY(response.endsWith("0\r\n\r\n"));
+
+    QVERIFY(response.contains("Transfer-Encoding: chunked"));
+    QVERIFY(response.endsWith("\r\n\r\n4\r\ntest\r\n4\r\ntest\r\n0\r\n\r\n"));
+
+    // The connection remains open for the next request
+    socket.write(Request);
+    QTRY_COMPARE(response.count(StatusLine), 2);
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+}
+
+void TestServer::testHeaderLimits_data()
+{
+    QTest::addColumn<QByteArray>("request");
+    QTest::addColumn<bool>("trickle");
+    QTest::addColumn<QByteArray>("statusLine");
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("long URI")
+            << QByteArray("GET /" + QByteArray(256, 'a'))
+            << false
+            << QByteArray("HTTP/1.1 414")
+            << QString();
+
+    QTest::newRow("large headers")
+            << QByteArray("GET /test HTTP/1.1\r\nX-Test: " + QByteArray(256, 'a'))
+            << false
+            << QByteArray("HTTP/1.1 431")
+            << QString();
+
+    QTest::newRow("too many headers")
+            << QByteArray("GET /test HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\nE: 5\r\n")
+            << false
+            << QByteArray("HTTP/1.1 431")
+            << QString();
+
+    QTest::newRow("too many headers trickled")
+            << QByteArray("GET /test HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\nE: 5\r\n")
+            << true
+            << QByteArray("HTTP/1.1 431")
+            << QString();
+
+    QTest::newRow("headers at limit trickled")
+            << QByteArray("GET /test HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\n\r\n")
+            << true
+            << QByteArray()
+            << QString("test");
+}
+
+void TestServer::testHeaderLimits()
+{
+    QFETCH(QByteArray, request);
+    QFETCH(bool, trickle);
+    QFETCH(QByteArray, statusLine);
+    QFETCH(QString, path);
+
+    TestHandler handler;
+    QHttpEngine::Server server(&handler);
+    server.setMaxHeaderSize(128);
+    server.setMaxHeaderCount(4);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The error must be sent without waiting for the rest of the headers -
+    // the headers may also arrive a single byte at a time
+    if (trickle) {
+        for (int i = 0; i < request.size(); ++i) {
+            socket.write(request.constData() + i, 1);
+            socket.flush();
+            QTest::qWait(1);
+        }
+    } else {
+        socket.write(request);
+    }
+    QTRY_VERIFY(response.startsWith(statusLine));
+    QTRY_COMPARE(handler.mPath, path);
+}
+
+void TestServer::testSocketOptions()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setNoDelay(true);
+    server.setCorkEnabled(true);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The complete response must arrive without waiting for more data
+    for (int i = 1; i <= 2; ++i) {
+        socket.write(Request);
+        QTRY_COMPARE(response.count(StatusLine), i);
+        QTRY_VERIFY(response.endsWith(Data));
+    }
+}
+
+void TestServer::testTimeouts_data()
+{
+    QTest::addColumn<QByteArray>("request");
+
+    QTest::newRow("idle") << QByteArray();
+    QTest::newRow("headers") << QByteArray("GET /test HTTP/1.1\r\n");
+    QTest::newRow("body") << QByteArray("POST /test HTTP/1.1\r\nContent-Length: 10\r\n\r\ntest");
+}
+
+void TestServer::testTimeouts()
+{
+    QFETCH(QByteArray, request);
+
+    // The handler never responds, which must not count against the client
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *) {});
+
+    QHttpEngine::Server server(&handler);
+    server.setIdleTimeout(100);
+    server.setHeaderTimeout(100);
+    server.setBodyTimeout(100);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    socket.write(request);
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+}
+
+void TestServer::testWriteTimeout()
+{
+    bool disconnected = false;
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&](QHttpEngine::Socket *socket) {
+        connect(socket, &QHttpEngine::Socket::disconnected, [&]() {
+            disconnected = true;
+        });
+        socket->write(QByteArray(32 * 1024 * 1024, 'a'));
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setWriteTimeout(100);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    // Stop receiving once the first byte of the response arrives
+    QTcpSocket socket;
+    socket.setReadBufferSize(1);
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    socket.write(Request);
+    QTRY_VERIFY(disconnected);
+}
+
+void TestServer::testExpectContinue()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        QByteArray data = socket->readAll();
+        socket->setHeader("Content-Length", QByteArray::number(data.length()));
+        socket->write(data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The body is only sent once the server asks for it
+    socket.write("POST /test HTTP/1.1\r\nContent-Length: 4\r\nExpect: 100-continue\r\n\r\n");
+    QTRY_COMPARE(response, QByteArray("HTTP/1.1 100 CONTINUE\r\n\r\n"));
+
+    socket.write(Data);
+    QTRY_VERIFY(response.endsWith(Data));
+    QVERIFY(response.contains(StatusLine));
+}
+
+void TestServer::testExpectContinueRejected()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->writeError(QHttpEngine::Socket::PayloadTooLarge);
+    }, false);
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The final response arrives right away and the connection is closed
+    // since the body was never sent
+    socket.write("POST /test HTTP/1.1\r\nContent-Length: 1048576\r\nExpect: 100-continue\r\n\r\n");
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+    QVERIFY(response.startsWith("HTTP/1.1 413 PAYLOAD TOO LARGE"));
+}
+
+void TestServer::testMaxBodySize_data()
+{
+    QTest::addColumn<QByteArray>("request");
+    QTest::addColumn<QByteArray>("statusLine");
+
+    QTest::newRow("within limit")
+            << QByteArray("POST /test HTTP/1.1\r\nContent-Length: 4\r\n\r\ntest")
+            << StatusLine;
+
+    QTest::newRow("content length")
+            << QByteArray("POST /test HTTP/1.1\r\nContent-Length: 16\r\n\r\n")
+            << QByteArray("HTTP/1.1 413");
+
+    QTest::newRow("chunked")
+            << QByteArray("POST /test HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n10\r\n" + QByteArray(16, 'a') + "\r\n")
+            << QByteArray("HTTP/1.1 413");
+
+    QTest::newRow("method limit")
+            << QByteArray("POST /small HTTP/1.1\r\nContent-Length: 4\r\n\r\n")
+            << QByteArray("HTTP/1.1 413");
+
+    QTest::newRow("raised method limit")
+            << QByteArray("POST /large HTTP/1.1\r\nContent-Length: 16\r\n\r\n" + QByteArray(16, 'a'))
+            << StatusLine;
+
+    QTest::newRow("raised method limit chunked")
+            << QByteArray("POST /large HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n10\r\n" + QByteArray(16, 'a') + "\r\n0\r\n\r\n")
+            << StatusLine;
+}
+
+void TestServer::testMaxBodySize()
+{
+    QFETCH(QByteArray, request);
+    QFETCH(QByteArray, statusLine);
+
+    // Respond once the body was received (a chunked body has no length)
+    auto echo = [](QHttpEngine::Socket *socket) {
+        connect(socket, &QHttpEngine::Socket::readChannelFinished, [socket]() {
+            QByteArray data = socket->readAll();
+            socket->setHeader("Content-Length", QByteArray::number(data.length()));
+            socket->write(data);
+            socket->close();
+        });
+    };
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", echo, false);
+    handler.registerMethod("small", echo, false);
+    handler.setMaxBodySize("small", 2);
+    handler.registerMethod("large", echo, false);
+    handler.setMaxBodySize("large", 32);
+
+    QHttpEngine::Server server(&handler);
+    server.setMaxBodySize(8);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write(request);
+    QTRY_VERIFY(response.startsWith(statusLine));
+}
+
+void TestServer::testBodyBuffer()
+{
+    QByteArray body;
+    for (int i = 0; i < 4096; ++i) {
+        body.append(static_cast<char>(i % 251));
+    }
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        QByteArray data = socket->readAll();
+        socket->setHeader("Content-Length", QByteArray::number(data.length()));
+        socket->write(data);
+        socket->close();
+    });
+
+    // Most of the body is stored in a temporary file until it is read
+    QHttpEngine::Server server(&handler);
+    server.setBodyBufferSize(64);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write("POST /test HTTP/1.1\r\nContent-Length: " + QByteArray::number(body.length()) + "\r\n\r\n");
+    for (int i = 0; i < body.length(); i += 1024) {
+        socket.write(body.mid(i, 1024));
+        QTest::qWait(10);
+    }
+
+    QTRY_VERIFY(response.endsWith(body));
+    QVERIFY(response.startsWith(StatusLine));
+}
+
+void TestServer::testBodyBufferStreaming()
+{
+    QByteArray body;
+    for (int i = 0; i < 262144; ++i) {
+        body.append(static_cast<char>(i % 251));
+    }
+
+    // The slot reads the body back from the temporary file in pieces
+    qint64 received = 0;
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&received](QHttpEngine::Socket *socket) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        char data[4096];
+        qint64 size;
+        while ((size = socket->read(data, sizeof(data))) > 0) {
+            hash.addData(data, size);
+            received += size;
+        }
+        QByteArray result = hash.result().toHex();
+        socket->setHeader("Content-Length", QByteArray::number(result.length()));
+        socket->write(result);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setBodyBufferSize(1024);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write("POST /test HTTP/1.1\r\nContent-Length: " + QByteArray::number(body.length()) + "\r\n\r\n");
+    socket.write(body);
+
+    QByteArray expected = QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex();
+    QTRY_VERIFY(response.endsWith(expected));
+    QCOMPARE(received, static_cast<qint64>(body.length()));
+}
+
+void TestServer::testConnectionPool()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setConnectionPoolSize(1);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    // Each client after the first is served by the connection that was used
+    // for the one before it
+    for (int i = 0; i < 3; ++i) {
+        QTcpSocket socket;
+        socket.connectToHost(server.serverAddress(), server.serverPort());
+        QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+        QByteArray response;
+        connect(&socket, &QTcpSocket::readyRead, [&]() {
+            response.append(socket.readAll());
+        });
+
+        socket.write("GET /test HTTP/1.1\r\nConnection: close\r\n\r\n");
+        QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+        QVERIFY(response.startsWith(StatusLine));
+        QVERIFY(response.endsWith(Data));
+    }
+}
+
+void TestServer::testErrorTemplate()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("custom", [](QHttpEngine::Socket *socket) {
+        socket->writeError(QHttpEngine::Socket::NotFound, "MISSING");
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setErrorTemplate("<p>%1 %2</p>");
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The first response is rendered in advance and the second (which has a
+    // custom reason) when it is written - both use the template
+    socket.write(
+        "GET /test HTTP/1.1\r\n\r\n"
+        "GET /custom HTTP/1.1\r\nConnection: close\r\n\r\n"
+    );
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+    QCOMPARE(response, QByteArray(
+        "HTTP/1.1 404 NOT FOUND\r\n"
+        "Content-Length: 20\r\n"
+        "Content-Type: text/html\r\n"
+        "\r\n"
+        "<p>404 NOT FOUND</p>"
+        "HTTP/1.1 404 MISSING\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 18\r\n"
+        "Content-Type: text/html\r\n"
+        "\r\n"
+        "<p>404 MISSING</p>"
+    ));
+}
+
+void TestServer::testWorkerThreads()
+{
+    QMutex mutex;
+    QSet<QThread*> threads;
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&](QHttpEngine::Socket *socket) {
+        mutex.lock();
+        threads.insert(QThread::currentThread());
+        mutex.unlock();
+
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setWorkerThreadCount(2);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    // Connections are spread across the workers while they are open
+    QList<QTcpSocket*> sockets;
+    for (int i = 0; i < 4; ++i) {
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->connectToHost(server.serverAddress(), server.serverPort());
+        QTRY_COMPARE(socket->state(), QAbstractSocket::ConnectedState);
+        sockets.append(socket);
+    }
+    QTRY_COMPARE(server.connectionCount(), 4);
+
+    foreach (QTcpSocket *socket, sockets) {
+        socket->write(Request);
+    }
+    foreach (QTcpSocket *socket, sockets) {
+        QTRY_VERIFY(socket->bytesAvailable());
+        QVERIFY(socket->readAll().startsWith(StatusLine));
+        socket->disconnectFromHost();
+    }
+    qDeleteAll(sockets);
+
+    QTRY_COMPARE(server.connectionCount(), 0);
+    QCOMPARE(threads.count(), 2);
+    QVERIFY(!threads.contains(QThread::currentThread()));
+}
+
+void TestServer::testReusePort()
+{
+#if !defined(Q_OS_UNIX)
+    QSKIP("SO_REUSEPORT is only supported on Unix");
+#endif
+
+    QMutex mutex;
+    QSet<QThread*> threads;
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&](QHttpEngine::Socket *socket) {
+        mutex.lock();
+        threads.insert(QThread::currentThread());
+        mutex.unlock();
+
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setWorkerThreadCount(2);
+    QVERIFY(server.listenReusePort(QHostAddress::LocalHost));
+    QVERIFY(server.serverPort() != 0);
+
+    // Which socket receives each connection is up to the system, so only
+    // check that every connection is served off the thread of the server
+    for (int i = 0; i < 8; ++i) {
+        QTcpSocket socket;
+        socket.connectToHost(server.serverAddress(), server.serverPort());
+        QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+        socket.write(Request);
+        QTRY_VERIFY(socket.bytesAvailable());
+        QVERIFY(socket.readAll().startsWith(StatusLine));
+    }
+
+    QVERIFY(threads.count() >= 1);
+    QVERIFY(!threads.contains(QThread::currentThread()));
+
+    // Draining closes the sockets of the workers as well (they are closed
+    // on their own threads, so it may take a moment)
+    quint16 port = server.serverPort();
+    server.drain();
+    QTRY_VERIFY(!server.isDraining());
+    QTRY_VERIFY(isRefused(port));
+}
+
+void TestServer::testHandOver()
+{
+#if defined(Q_OS_UNIX)
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+        socket->setHeader("Content-Length", QByteArray::number(pid.length()));
+        socket->write(pid);
+        socket->close();
+    });
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/handover";
+
+    // The new process is forked before the old server exists, so that it
+    // shares nothing with it other than what is handed over
+    pid_t pid = fork();
+    if (pid == 0) {
+        QHttpEngine::Server server(&handler);
+        if (!server.adoptListeningDescriptor(path, 5000)) {
+            std::_Exit(1);
+        }
+        QEventLoop loop;
+        QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+        loop.exec();
+        std::_Exit(0);
+    }
+    QVERIFY(pid != -1);
+    QByteArray newPid = QByteArray::number(static_cast<qint64>(pid));
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QTcpSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    socket.write(Request);
+    QTRY_VERIFY(response.endsWith(QByteArray::number(QCoreApplication::applicationPid())));
+
+    // The new process may not be waiting yet
+    quint16 port = server.serverPort();
+    QSignalSpy drainedSpy(&server, SIGNAL(drained()));
+    QTRY_VERIFY(server.handOver(path, true));
+    QVERIFY(server.isDraining());
+
+    // The idle connection leaves this process without being closed
+    QTRY_COMPARE(server.connectionCount(), 0);
+    QTRY_COMPARE(drainedSpy.count(), 1);
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    // Both it and new connections are served by the new process
+    response.clear();
+    socket.write(Request);
+    QTRY_VERIFY(response.endsWith(newPid));
+
+    QTcpSocket newSocket;
+    newSocket.connectToHost(QHostAddress::LocalHost, port);
+    QTRY_COMPARE(newSocket.state(), QAbstractSocket::ConnectedState);
+    newSocket.write(Request);
+    QByteArray newResponse;
+    QTRY_VERIFY(newResponse.append(newSocket.readAll()).endsWith(newPid));
+
+    kill(pid, SIGKILL);
+    waitpid(pid, 0, 0);
+#else
+    QSKIP("Handing over sockets is only supported on Unix");
+#endif
+}
+
+void TestServer::testHandOverReusePort()
+{
+#if defined(Q_OS_UNIX)
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/handover";
+
+    QHttpEngine::Server server(&handler);
+    server.setWorkerThreadCount(2);
+    QVERIFY(server.listenReusePort(QHostAddress::LocalHost));
+
+    // The socket of the server does not listen, so it cannot be handed over
+    // and the server carries on as before
+    QVERIFY(!server.handOver(path));
+    QVERIFY(!server.isDraining());
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+    socket.write(Request);
+    QTRY_VERIFY(socket.bytesAvailable());
+    QVERIFY(socket.readAll().startsWith(StatusLine));
+#else
+    QSKIP("Handing over sockets is only supported on Unix");
+#endif
+}
+
+void TestServer::testHandOverPathInUse()
+{
+#if defined(Q_OS_UNIX)
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/handover";
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+
+    // Only a socket left behind at the path may be replaced
+    TestHandler handler;
+    QHttpEngine::Server server(&handler);
+    QVERIFY(!server.adoptListeningDescriptor(path, 100));
+    QVERIFY(QFileInfo(path).isFile());
+#endif
+}
+
+void TestServer::testLocal()
+{
+    QHostAddress peerAddress(QHostAddress::LocalHost);
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [&](QHttpEngine::Socket *socket) {
+        peerAddress = socket->peerAddress();
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listenLocal(QString("qhttpengine-test-%1").arg(QCoreApplication::applicationPid())));
+    QVERIFY(!server.localServerName().isEmpty());
+
+    QLocalSocket socket;
+    socket.connectToServer(server.localServerName());
+    QTRY_COMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&socket, &QLocalSocket::readyRead, [&]() {
+        response.append(socket.readAll());
+    });
+
+    // The connection is kept alive just like a TCP connection
+    for (int i = 1; i <= 2; ++i) {
+        socket.write(Request);
+        QTRY_COMPARE(response.count(StatusLine), i);
+    }
+    QVERIFY(peerAddress.isNull());
+
+    // Draining stops listening on the local socket as well
+    QString name = server.localServerName();
+    server.drain();
+    QTRY_COMPARE(socket.state(), QLocalSocket::UnconnectedState);
+
+    QLocalSocket newSocket;
+    newSocket.connectToServer(name);
+    QTRY_COMPARE(newSocket.state(), QLocalSocket::UnconnectedState);
+}
+
+void TestServer::testMaxConnections()
+{
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+
+    QHttpEngine::Server server(&handler);
+    server.setMaxConnections(1);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket first;
+    first.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(first.state(), QAbstractSocket::ConnectedState);
+    first.write(Request);
+    QTRY_VERIFY(first.bytesAvailable());
+    QCOMPARE(server.connectionCount(), 1);
+
+    // The second client is not served until the first one disconnects
+    QTcpSocket second;
+    second.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(second.state(), QAbstractSocket::ConnectedState);
+    second.write(Request);
+    QTest::qWait(100);
+    QCOMPARE(second.bytesAvailable(), 0);
+
+    first.disconnectFromHost();
+    QTRY_VERIFY(second.bytesAvailable());
+    QVERIFY(second.readAll().startsWith(StatusLine));
+    QCOMPARE(server.connectionCount(), 1);
+    QCOMPARE(server.waitingConnectionCount(), 0);
+}
+
+void TestServer::testRejectConnections()
+{
+    TestHandler handler;
+    QHttpEngine::Server server(&handler);
+    server.setMaxConnections(1);
+    server.setOverloadPolicy(QHttpEngine::Server::RejectConnections);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket first;
+    first.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(first.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE(server.connectionCount(), 1);
+
+    QTcpSocket second;
+    second.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(second.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&second, &QTcpSocket::readyRead, [&]() {
+        response.append(second.readAll());
+    });
+
+    // The second client is turned away without sending anything
+    QTRY_COMPARE(second.state(), QAbstractSocket::UnconnectedState);
+    QVERIFY(response.startsWith("HTTP/1.1 503"));
+    QVERIFY(response.contains("Connection: close"));
+    QCOMPARE(server.rejectedConnectionCount(), static_cast<qint64>(1));
+    QCOMPARE(server.connectionCount(), 1);
+}
+
+void TestServer::testDrain()
+{
+    QPointer<QHttpEngine::Socket> pending;
+
+    QHttpEngine::QObjectHandler handler;
+    handler.registerMethod("test", [](QHttpEngine::Socket *socket) {
+        socket->setHeader("Content-Length", QByteArray::number(Data.length()));
+        socket->write(Data);
+        socket->close();
+    });
+    handler.registerMethod("pending", [&pending](QHttpEngine::Socket *socket) {
+        pending = socket;
+    });
+
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QSignalSpy drainedSpy(&server, SIGNAL(drained()));
+
+    // The first client is idle after its response and the second is waiting
+    // for a response when the server begins draining
+    QTcpSocket idleSocket;
+    idleSocket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(idleSocket.state(), QAbstractSocket::ConnectedState);
+    idleSocket.write(Request);
+    QTRY_VERIFY(idleSocket.bytesAvailable());
+
+    QTcpSocket pendingSocket;
+    pendingSocket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(pendingSocket.state(), QAbstractSocket::ConnectedState);
+
+    QByteArray response;
+    connect(&pendingSocket, &QTcpSocket::readyRead, [&]() {
+        response.append(pendingSocket.readAll());
+    });
+
+    pendingSocket.write("GET /pending HTTP/1.1\r\n\r\n");
+    QTRY_VERIFY(pending);
+
+    server.drain();
+    QVERIFY(server.isDraining());
+    QVERIFY(!server.isListening());
+
+    // The idle connection is closed right away while the other one remains
+    // open until its response is written
+    QTRY_COMPARE(idleSocket.state(), QAbstractSocket::UnconnectedState);
+    QCOMPARE(pendingSocket.state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(drainedSpy.count(), 0);
+
+    pending->setHeader("Content-Length", QByteArray::number(Data.length()));
+    pending->write(Data);
+    pending->close();
+
+    QTRY_COMPARE(drainedSpy.count(), 1);
+    QTRY_COMPARE(pendingSocket.state(), QAbstractSocket::UnconnectedState);
+    QVERIFY(response.startsWith(StatusLine));
+    QVERIFY(response.contains("Connection: close"));
+    QVERIFY(response.endsWith(Data));
+    QVERIFY(!server.isDraining());
+}
+
+void TestServer::testDrainTimeout()
+{
+    TestHandler handler;
+    QHttpEngine::Server server(&handler);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QSignalSpy drainedSpy(&server, SIGNAL(drained()));
+
+    // The request is never completed, so the connection remains open until
+    // the deadline passes
+    QTcpSocket socket;
+    socket.connectToHost(server.serverAddress(), server.serverPort());
+    QTRY_COMPARE(socket.state(), QAbstractSocket::ConnectedState);
+    socket.write("GET /test HTTP/1.1\r\n");
+    QTest::qWait(50);
+
+    server.drain(100);
+
+    QTRY_COMPARE(drainedSpy.count(), 1);
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+}
+
 #if !defined(QT_NO_SSL)
 void TestServer::testSsl()
 {
@@ -62,7 +62,11 @@ private Q_SLOTS:
     void testProperties();
     void testData();
     void testRedirect();
+    void testHead();
     void testSignals();
+    void testChunkedData();
+    void testWriteWatermarks();
+    void testSegments();
     void testJson();
 
 private:
@@ -126,6 +130,27 @@ void TestSocket::testRedirect()
     QTRY_COMPARE(disconnectedSpy.count(), 1);
 }
 
+void TestSocket::testHead()
+{
+    CREATE_SOCKET_PAIR();
+
+    QSignalSpy disconnectedSpy(pair.client(), SIGNAL(disconnected()));
+
+    client.sendHeaders("HEAD", Path);
+    QTRY_VERIFY(server->isHeadersParsed());
+
+    // The body is accepted but never sent
+    server->setHeader("Content-Length", QByteArray::number(Data.length()));
+    server->writeHeaders();
+    QCOMPARE(server->write(Data), static_cast<qint64>(Data.length()));
+    server->close();
+
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(client.statusCode(), static_cast<int>(QHttpEngine::Socket::OK));
+    QCOMPARE(client.headers().value("Content-Length").toInt(), Data.length());
+    QCOMPARE(client.data(), QByteArray());
+}
+
 void TestSocket::testSignals()
 {
     CREATE_SOCKET_PAIR();
@@ -165,6 +190,78 @@ void TestSocket::testSignals()
     QCOMPARE(readChannelFinishedSpy.count(), 1);
 }
 
+void TestSocket::testChunkedData()
+{
+    CREATE_SOCKET_PAIR();
+
+    QSignalSpy readChannelFinishedSpy(server, SIGNAL(readChannelFinished()));
+
+    client.sendHeaders(Method, Path, QHttpEngine::Socket::HeaderMap{
+        {"Transfer-Encoding", "chunked"}
+    });
+    QTRY_VERIFY(server->isHeadersParsed());
+    QCOMPARE(server->contentLength(), -1);
+
+    // Each chunk should be available as soon as it arrives
+    client.sendData("4\r\ntest\r\n");
+    QTRY_COMPARE(server->bytesAvailable(), Data.length());
+    QCOMPARE(readChannelFinishedSpy.count(), 0);
+    QVERIFY(!server->isReadFinished());
+
+    client.sendData("4;ext=1\r\ntest\r\n0\r\n\r\n");
+    QTRY_COMPARE(readChannelFinishedSpy.count(), 1);
+    QVERIFY(server->isReadFinished());
+    QCOMPARE(server->readAll(), Data + Data);
+}
+
+void TestSocket::testWriteWatermarks()
+{
+    CREATE_SOCKET_PAIR();
+
+    QSignalSpy writeBufferDrainedSpy(server, SIGNAL(writeBufferDrained()));
+
+    server->setWriteWatermarks(Data.length() * 2, Data.length());
+    server->writeHeaders();
+    server->write(Data);
+    QVERIFY(!server->canWrite());
+
+    // Writing is possible again once the client has received the data
+    QTRY_COMPARE(writeBufferDrainedSpy.count(), 1);
+    QVERIFY(server->canWrite());
+    QCOMPARE(server->bytesToWrite(), 0);
+}
+
+void TestSocket::testSegments()
+{
+    CREATE_SOCKET_PAIR();
+
+    QHttpEngine::Socket::HeaderMap segmentHeaders;
+    segmentHeaders.insert("Content-Length", QByteArray::number(Data.length() * 2));
+
+    client.sendHeaders(Method, Path, segmentHeaders);
+    QTRY_VERIFY(server->isHeadersParsed());
+    QCOMPARE(server->peekSegment(), QByteArray());
+
+    // Peeking leaves the data in place until it is consumed
+    client.sendData(Data);
+    QTRY_COMPARE(server->bytesAvailable(), Data.length());
+    QCOMPARE(server->peekSegment(), Data);
+    QCOMPARE(server->consume(1), 1);
+    QCOMPARE(server->peekSegment(), Data.mid(1));
+    QCOMPARE(server->bytesAvailable(), Data.length() - 1);
+
+    // Segments can be mixed with regular reads
+    client.sendData(Data);
+    QTRY_COMPARE(server->bytesAvailable(), Data.length() * 2 - 1);
+    QCOMPARE(server->read(2), Data.mid(1, 2));
+    QByteArray rest;
+    for (QByteArray data = server->readSegment(); data.size(); data = server->readSegment()) {
+        rest.append(data);
+    }
+    QCOMPARE(rest, Data.mid(3) + Data);
+    QCOMPARE(server->consume(1), 0);
+}
+
 void TestSocket::testJson()
 {
     CREATE_SOCKET_PAIR();